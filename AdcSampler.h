@@ -0,0 +1,98 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <Arduino.h>
+
+#define ADC_BURST_SAMPLES 9
+#define ADC_BURST_SPACING_MS 20 // Back to back analogRead() calls disturb the WiFi
+#define ADC_BURST_INTERVAL_MS 30000
+#define ADC_EMA_SHIFT 2 // Weight of a new burst is 1/4
+#define ADC_Q 8 // Fractional bits of the smoothed values
+
+// Oversampled ADC input, driven from loop() without blocking.
+// A burst of ADC_BURST_SAMPLES readings is spread ADC_BURST_SPACING_MS apart.
+// Its median (robust to switching spikes) feeds an integer exponential moving
+// average. The median absolute deviation of the burst, smoothed the same way,
+// is the noise estimate. Everything is in ADC counts, fixed-point Q8.
+class AdcSampler {
+    public:
+        AdcSampler(uint8_t pin) : pin(pin) {};
+
+        // True when a burst just completed
+        bool update(unsigned long now){
+            if (this->count == 0){
+              if (this->bursts > 0 && now - this->burstStart < ADC_BURST_INTERVAL_MS)
+                return false;
+              this->burstStart = now;
+            }
+            else if (now - this->lastSample < ADC_BURST_SPACING_MS){
+              return false;
+            }
+
+            this->last = analogRead(this->pin);
+            this->burst[this->count++] = this->last;
+            this->lastSample = now;
+            this->samples++;
+            if (this->count < ADC_BURST_SAMPLES)
+              return false;
+
+            this->count = 0;
+            finishBurst();
+            return true;
+        };
+
+        // Last single reading
+        uint16_t getLast(){ return this->last; };
+        // Smoothed median, ADC counts << ADC_Q
+        uint32_t getSmoothed(){ return this->smoothed; };
+        // Smoothed median absolute deviation, ADC counts << ADC_Q
+        uint32_t getNoise(){ return this->noise; };
+        unsigned long getSamples(){ return this->samples; };
+        unsigned long getBursts(){ return this->bursts; };
+
+    private:
+        uint8_t pin;
+        uint16_t burst[ADC_BURST_SAMPLES];
+        uint8_t count = 0;
+        uint16_t last = 0;
+        unsigned long burstStart = 0;
+        unsigned long lastSample = 0;
+        unsigned long samples = 0;
+        unsigned long bursts = 0;
+        uint32_t smoothed = 0;
+        uint32_t noise = 0;
+
+        static uint16_t median(uint16_t * values, uint8_t n){
+            for (uint8_t i = 1; i < n; i++){
+              uint16_t v = values[i];
+              int8_t j = i - 1;
+              while (j >= 0 && values[j] > v){
+                values[j + 1] = values[j];
+                j--;
+              }
+              values[j + 1] = v;
+            }
+            return values[n / 2];
+        };
+
+        static void smooth(uint32_t &average, uint32_t value, bool first){
+            if (first)
+              average = value;
+            else
+              average = average + ((int32_t) (value - average) >> ADC_EMA_SHIFT);
+        };
+
+        void finishBurst(){
+            uint16_t center = median(this->burst, ADC_BURST_SAMPLES);
+            for (uint8_t i = 0; i < ADC_BURST_SAMPLES; i++)
+              this->burst[i] = this->burst[i] > center ? this->burst[i] - center : center - this->burst[i];
+            uint16_t deviation = median(this->burst, ADC_BURST_SAMPLES);
+
+            bool first = this->bursts == 0;
+            smooth(this->smoothed, (uint32_t) center << ADC_Q, first);
+            smooth(this->noise, (uint32_t) deviation << ADC_Q, first);
+            this->bursts++;
+        };
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include "config.h"
+#include "Journal.h"
+
+#define ASSET_CACHE_ENTRIES 8
+#define ASSET_PATH_MAX 48
+#define ASSET_ETAG_MAX 20
+
+// What handleFileRead needs to know about a static file without touching the
+// file system: whether it exists, whether it is served from its ".gz" variant,
+// its size and its strong ETag
+typedef struct {
+    char path[ASSET_PATH_MAX]; // Requested path, without ".gz"
+    bool exists;
+    bool gzip;
+    uint32_t size;
+    char etag[ASSET_ETAG_MAX];
+    uint32_t lastUsed;
+} AssetEntry;
+
+// Small LRU of file metadata, filled on first request. The ETag is the CRC-32
+// of the served bytes and their size, so it survives reboots and identical
+// re-uploads; it is computed once per fill, not per request.
+// Anything writing to the file system through the web server calls clear().
+// The journal and configuration files change under the firmware's own hands,
+// they are probed on every request and get no ETag.
+class AssetCache {
+    public:
+        static bool isStatic(const String &path){
+            return strncmp(path.c_str(), JOURNAL_DIR "/", sizeof(JOURNAL_DIR)) != 0 && strncmp(path.c_str(), "/config/", 8) != 0;
+        };
+
+        // Never null. Live files and paths too long to be cached are probed into a scratch entry
+        const AssetEntry * lookup(const String &path){
+            if (!isStatic(path)) {
+              probe(path, this->scratch, false);
+              return &this->scratch;
+            }
+
+            this->clock++;
+            if (path.length() < ASSET_PATH_MAX) {
+              for (uint8_t i = 0; i < this->count; i++) {
+                if (strcmp(this->entries[i].path, path.c_str()) == 0) {
+                  this->entries[i].lastUsed = this->clock;
+                  this->hits++;
+                  return &this->entries[i];
+                }
+              }
+            }
+            this->misses++;
+
+            AssetEntry * entry = &this->scratch;
+            if (path.length() < ASSET_PATH_MAX) {
+              entry = this->count < ASSET_CACHE_ENTRIES ? &this->entries[this->count++] : oldest();
+              strcpy(entry->path, path.c_str());
+            } else {
+              entry->path[0] = '\0';
+            }
+            probe(path, *entry, true);
+            entry->lastUsed = this->clock;
+            return entry;
+        };
+
+        void clear(){
+            this->count = 0;
+        };
+
+        uint32_t getHits(){ return this->hits; };
+        uint32_t getMisses(){ return this->misses; };
+
+    private:
+        AssetEntry entries[ASSET_CACHE_ENTRIES];
+        AssetEntry scratch;
+        uint8_t count = 0;
+        uint32_t clock = 0;
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+
+        AssetEntry * oldest(){
+            AssetEntry * entry = &this->entries[0];
+            for (uint8_t i = 1; i < ASSET_CACHE_ENTRIES; i++) {
+              if (this->entries[i].lastUsed < entry->lastUsed)
+                entry = &this->entries[i];
+            }
+            return entry;
+        };
+
+        static void probe(const String &path, AssetEntry &entry, bool hash){
+            entry.exists = false;
+            entry.gzip = false;
+            entry.size = 0;
+            entry.etag[0] = '\0';
+
+            File file = LittleFS.open(path, "r");
+            if (!file || file.isDirectory()) {
+              file = LittleFS.open(path + ".gz", "r");
+              entry.gzip = true;
+            }
+            if (!file || file.isDirectory())
+              return;
+
+            entry.exists = true;
+            entry.size = file.size();
+            if (!hash)
+              return;
+
+            uint8_t buffer[128];
+            uint32_t crc = 0;
+            size_t length;
+            while ((length = file.read(buffer, sizeof(buffer))) > 0)
+              crc = ConfigurationFactory_crc32(buffer, length, crc);
+
+            snprintf(entry.etag, sizeof(entry.etag), "\"%08x-%x\"", (unsigned) crc, (unsigned) entry.size);
+            file.close();
+        };
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef CHUNKED_PRINT_H
+#define CHUNKED_PRINT_H
+
+#include <Arduino.h>
+#include "WebServerBackend.h"
+#include "HeapMonitor.h"
+
+#define CHUNKED_PRINT_BUFFER 256
+
+// Print sink for streamed responses: output is gathered in a fixed buffer
+// sent as one HTTP chunk whenever it fills up, so bodies of any length are
+// written with constant memory.
+//
+//   ChunkedPrint out(server);
+//   out.begin(200, "application/json");
+//   out.printf(...);
+//   out.end();
+class ChunkedPrint : public Print {
+    public:
+        ChunkedPrint(WebServerBackend &server) : server(server) {};
+
+        // HTTP/1.0 clients get a close-delimited body instead
+        void begin(int code, const char * contentType){
+            if (!this->server.chunkedResponseModeStart(code, contentType)) {
+              this->server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+              this->server.send(code, contentType, "");
+            }
+        };
+
+        void end(){
+            flush();
+            this->server.chunkedResponseFinalize();
+        };
+
+        using Print::write;
+
+        size_t write(uint8_t c) override {
+            if (this->length == CHUNKED_PRINT_BUFFER)
+              flush();
+            this->buffer[this->length++] = c;
+            return 1;
+        };
+
+        size_t write(const uint8_t * data, size_t size) override {
+            size_t written = size;
+            while (size > 0) {
+              if (this->length == CHUNKED_PRINT_BUFFER)
+                flush();
+              size_t n = CHUNKED_PRINT_BUFFER - this->length;
+              if (n > size)
+                n = size;
+              memcpy(this->buffer + this->length, data, n);
+              this->length += n;
+              data += n;
+              size -= n;
+            }
+            return written;
+        };
+
+        void flush() override {
+            if (this->length == 0)
+              return;
+            Heap.sample();
+            this->server.sendContent((const char *) this->buffer, this->length);
+            this->length = 0;
+        };
+
+    private:
+        WebServerBackend &server;
+        uint8_t buffer[CHUNKED_PRINT_BUFFER];
+        size_t length = 0;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef COMPACT_WRITER_H
+#define COMPACT_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum {
+  COMPACT_CBOR, // RFC 8949, application/cbor
+  COMPACT_MSGPACK // application/msgpack
+} CompactFormat;
+
+// Writes CBOR or MessagePack into a caller's buffer, always with the smallest
+// encoding of each integer. Containers are sized up front (no indefinite
+// lengths), floats are single precision like the App's. Nothing is written
+// past the capacity, overflowed() tells the result is unusable.
+//
+//   uint8_t buffer[64];
+//   CompactWriter out(buffer, sizeof(buffer), COMPACT_CBOR);
+//   out.map(1);
+//   out.key(0);
+//   out.real(7.2f);
+//   send(200, out.contentType(), (const char *) buffer, out.size());
+class CompactWriter {
+    public:
+        CompactWriter(uint8_t * buffer, size_t capacity, CompactFormat format) : buffer(buffer), capacity(capacity), format(format) {};
+
+        void map(size_t n){
+            if (this->format == COMPACT_CBOR)
+              head(0xa0, n);
+            else if (n < 16)
+              put(0x80 | n);
+            else
+              sized(0xde, n, 2);
+        };
+
+        void array(size_t n){
+            if (this->format == COMPACT_CBOR)
+              head(0x80, n);
+            else if (n < 16)
+              put(0x90 | n);
+            else
+              sized(0xdc, n, 2);
+        };
+
+        // Map keys are small integers, see the key table of the producer
+        void key(uint8_t k){ unsignedInt(k); };
+
+        void unsignedInt(uint64_t v){
+            if (this->format == COMPACT_CBOR)
+              return head(0x00, v);
+            if (v < 128)
+              put(v);
+            else if (v <= 0xff)
+              sized(0xcc, v, 1);
+            else if (v <= 0xffff)
+              sized(0xcd, v, 2);
+            else if (v <= 0xffffffff)
+              sized(0xce, v, 4);
+            else
+              sized(0xcf, v, 8);
+        };
+
+        void signedInt(int64_t v){
+            if (v >= 0)
+              return unsignedInt(v);
+            if (this->format == COMPACT_CBOR)
+              return head(0x20, (uint64_t) (-1 - v));
+            if (v >= -32)
+              put((uint8_t) v);
+            else if (v >= INT8_MIN)
+              sized(0xd0, (uint8_t) v, 1);
+            else if (v >= INT16_MIN)
+              sized(0xd1, (uint16_t) v, 2);
+            else if (v >= INT32_MIN)
+              sized(0xd2, (uint32_t) v, 4);
+            else
+              sized(0xd3, (uint64_t) v, 8);
+        };
+
+        void real(float v){
+            uint32_t bits;
+            memcpy(&bits, &v, sizeof(bits));
+            sized(this->format == COMPACT_CBOR ? 0xfa : 0xca, bits, 4);
+        };
+
+        void boolean(bool v){
+            if (this->format == COMPACT_CBOR)
+              put(v ? 0xf5 : 0xf4);
+            else
+              put(v ? 0xc3 : 0xc2);
+        };
+
+        void string(const char * s){
+            size_t n = strlen(s);
+            if (this->format == COMPACT_CBOR)
+              head(0x60, n);
+            else if (n < 32)
+              put(0xa0 | n);
+            else if (n <= 0xff)
+              sized(0xd9, n, 1);
+            else
+              sized(0xda, n, 2);
+            bytes((const uint8_t *) s, n);
+        };
+
+        size_t size() const { return this->length; };
+        bool overflowed() const { return this->overflow; };
+
+        const char * contentType() const {
+            return this->format == COMPACT_CBOR ? "application/cbor" : "application/msgpack";
+        };
+
+    private:
+        uint8_t * buffer;
+        size_t capacity;
+        CompactFormat format;
+        size_t length = 0;
+        bool overflow = false;
+
+        void put(uint8_t byte){
+            if (this->length == this->capacity) {
+              this->overflow = true;
+              return;
+            }
+            this->buffer[this->length++] = byte;
+        };
+
+        void bytes(const uint8_t * data, size_t n){
+            for (size_t i = 0; i < n; i++)
+              put(data[i]);
+        };
+
+        // Type byte then v big endian on size bytes
+        void sized(uint8_t type, uint64_t v, uint8_t size){
+            put(type);
+            for (int8_t shift = (size - 1) * 8; shift >= 0; shift -= 8)
+              put(v >> shift);
+        };
+
+        // CBOR initial byte: major type and argument
+        void head(uint8_t major, uint64_t v){
+            if (v < 24)
+              put(major | v);
+            else if (v <= 0xff)
+              sized(major | 24, v, 1);
+            else if (v <= 0xffff)
+              sized(major | 25, v, 2);
+            else if (v <= 0xffffffff)
+              sized(major | 26, v, 4);
+            else
+              sized(major | 27, v, 8);
+        };
+};
+
+#endif
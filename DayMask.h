@@ -0,0 +1,59 @@
+#ifndef DAY_MASK_H
+#define DAY_MASK_H
+
+#include <stdint.h>
+#include <string.h>
+#include "timer.h"
+
+#define DAY_MIN (DAY_H * HOUR_MIN) //Number of minutes in a day
+
+// One bit per minute of the day (1440 bits => 180 bytes).
+// Built once when the timetable is generated, then queried in constant time.
+class DayMask {
+    public:
+        DayMask(){
+            clear();
+        };
+
+        void clear(){
+            memset(this->bits, 0, sizeof(this->bits));
+        };
+
+        // Marks [onMin, offMin] (both inclusive) as active.
+        void setRange(unsigned int onMin, unsigned int offMin){
+            if (offMin >= DAY_MIN)
+              offMin = DAY_MIN - 1;
+
+            for (unsigned int m = onMin; m <= offMin; m++){
+                this->bits[m >> 3] |= (1 << (m & 7));
+            }
+        };
+
+        bool test(unsigned int minute) const {
+            if (minute >= DAY_MIN)
+              return false;
+            return this->bits[minute >> 3] & (1 << (minute & 7));
+        };
+
+        // Minutes until the mask value differs from the one at `minute`,
+        // wrapping over midnight. Returns -1 when the whole day is uniform.
+        int nextChange(unsigned int minute) const {
+            if (minute >= DAY_MIN)
+              minute = DAY_MIN - 1;
+
+            bool current = test(minute);
+            for (unsigned int i = 1; i < DAY_MIN; i++){
+                unsigned int m = minute + i;
+                if (m >= DAY_MIN)
+                  m -= DAY_MIN;
+                if (test(m) != current)
+                  return i;
+            }
+            return -1;
+        };
+
+    private:
+        uint8_t bits[DAY_MIN / 8];
+};
+
+#endif
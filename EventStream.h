@@ -0,0 +1,151 @@
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include "Log.h"
+
+#define EVENT_MAX_SUBSCRIBERS 3
+#define EVENT_QUEUE_BYTES 768 // Per subscriber, the largest event must fit
+#define EVENT_HEAD_BYTES 48 // "id: ...\nevent: ...\ndata: " of an event
+#define EVENT_DATA_MAX (EVENT_QUEUE_BYTES - EVENT_HEAD_BYTES - 2) // Longest data of an event, the closing "\n\n" set aside
+#define EVENT_KEEPALIVE_MS 15000
+#define EVENT_RETRY_MS 3000 // Reconnection delay asked of the browser
+
+typedef struct {
+  WiFiClient client;
+  bool active;
+  char queue[EVENT_QUEUE_BYTES];
+  uint16_t start;
+  uint16_t end;
+  unsigned long lastWrite; // ms
+} EventSubscriber;
+
+// Server-sent events (text/event-stream) to a few long-lived connections.
+// Events are queued per subscriber and written as the TCP window allows from
+// service(), never blocking loop(). A subscriber whose queue overflows is
+// disconnected: its browser reconnects after EVENT_RETRY_MS and starts over
+// from a snapshot, which is cheaper than tracking what it missed.
+class EventStream {
+    public:
+        // Takes over a connection whose request has been read, -1 when all slots are taken
+        int8_t subscribe(WiFiClient client){
+            for (uint8_t i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+              EventSubscriber &s = this->subscribers[i];
+              if (s.active)
+                continue;
+              s.client = client;
+              s.client.setNoDelay(true);
+              s.active = true;
+              s.start = s.end = 0;
+              s.lastWrite = millis();
+              char head[160];
+              int n = snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n"
+                "Access-Control-Allow-Origin: *\r\nConnection: keep-alive\r\n\r\nretry: %u\n\n", EVENT_RETRY_MS);
+              enqueue(s, head, n);
+              this->subscribed++;
+              return i;
+            }
+            return -1;
+        };
+
+        // One event to every subscriber, or only to subscriber only
+        void publish(const char * event, uint32_t id, const char * data, int8_t only = -1){
+            char head[EVENT_HEAD_BYTES];
+            int n = snprintf(head, sizeof(head), "id: %u\nevent: %s\ndata: ", (unsigned) id, event);
+            for (uint8_t i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+              EventSubscriber &s = this->subscribers[i];
+              if (!s.active || (only >= 0 && only != i))
+                continue;
+              // Whole event or nothing, a half-queued event would corrupt the stream.
+              // A burst (the snapshot) goes to the TCP window before giving up
+              size_t length = strlen(data);
+              if (room(s) < n + length + 2)
+                flush(s);
+              if (room(s) < n + length + 2) {
+                LOG_WARN("Event subscriber %u too slow, disconnected", i);
+                this->overflows++;
+                close(s);
+                continue;
+              }
+              enqueue(s, head, n);
+              enqueue(s, data, length);
+              enqueue(s, "\n\n", 2);
+            }
+            this->published++;
+        };
+
+        // Writes queued events without blocking, detects closed connections
+        void service(){
+            for (uint8_t i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+              EventSubscriber &s = this->subscribers[i];
+              if (!s.active)
+                continue;
+              if (!s.client.connected()) {
+                close(s);
+                continue;
+              }
+              if (s.start == s.end && millis() - s.lastWrite > EVENT_KEEPALIVE_MS)
+                enqueue(s, ":\n\n", 3); // Comment, keeps proxies open and finds dead peers
+              flush(s);
+            }
+        };
+
+        bool hasSubscribers(){ return count() > 0; };
+
+        uint8_t count(){
+            uint8_t n = 0;
+            for (uint8_t i = 0; i < EVENT_MAX_SUBSCRIBERS; i++) {
+              if (this->subscribers[i].active)
+                n++;
+            }
+            return n;
+        };
+
+        unsigned long getSubscribed(){ return this->subscribed; };
+        unsigned long getPublished(){ return this->published; };
+        unsigned long getOverflows(){ return this->overflows; };
+
+    private:
+        EventSubscriber subscribers[EVENT_MAX_SUBSCRIBERS] = {};
+        unsigned long subscribed = 0;
+        unsigned long published = 0;
+        unsigned long overflows = 0;
+
+        static size_t room(EventSubscriber &s){
+            return EVENT_QUEUE_BYTES - (s.end - s.start);
+        };
+
+        static void enqueue(EventSubscriber &s, const char * data, size_t size){
+            if ((size_t) (EVENT_QUEUE_BYTES - s.end) < size) {
+              memmove(s.queue, s.queue + s.start, s.end - s.start);
+              s.end -= s.start;
+              s.start = 0;
+            }
+            memcpy(s.queue + s.end, data, size);
+            s.end += size;
+        };
+
+        static void flush(EventSubscriber &s){
+            size_t pending = s.end - s.start;
+            if (pending == 0)
+              return;
+            int window = s.client.availableForWrite();
+            if (window <= 0)
+              return;
+            size_t n = s.client.write((const uint8_t *) s.queue + s.start, pending < (size_t) window ? pending : (size_t) window);
+            if (n > 0)
+              s.lastWrite = millis();
+            s.start += n;
+            if (s.start == s.end)
+              s.start = s.end = 0;
+        };
+
+        static void close(EventSubscriber &s){
+            s.client.stop();
+            s.client = WiFiClient();
+            s.active = false;
+        };
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <stdint.h>
+
+#define FIXED_FRAC 16
+#define FIXED_GAIN_FRAC 24
+
+// Signed Q16.16 number, the ESP8266 has no FPU and soft-float costs
+// hundreds of cycles per operation. Range is +-32767 with 1/65536 steps.
+class Fixed {
+    public:
+        int32_t raw;
+
+        static Fixed fromRaw(int32_t raw){ Fixed f; f.raw = raw; return f; };
+        static Fixed fromInt(int32_t value){ return fromRaw(value << FIXED_FRAC); };
+        // Value with frac fractional bits, e.g. DS18B20 readings (frac 7) or ADC counts in Q8
+        static Fixed fromQ(int32_t value, uint8_t frac){
+            return fromRaw(frac <= FIXED_FRAC ? value << (FIXED_FRAC - frac) : value >> (frac - FIXED_FRAC));
+        };
+        // For constants and calibration only, not on the sample path
+        static Fixed fromFloat(float value){
+            return fromRaw((int32_t) (value * (1 << FIXED_FRAC) + (value >= 0 ? 0.5f : -0.5f)));
+        };
+
+        float toFloat() const { return this->raw / (float) (1 << FIXED_FRAC); };
+
+        Fixed operator+(Fixed other) const { return fromRaw(this->raw + other.raw); };
+        Fixed operator-(Fixed other) const { return fromRaw(this->raw - other.raw); };
+        Fixed operator*(Fixed other) const { return fromRaw((int32_t) (((int64_t) this->raw * other.raw) >> FIXED_FRAC)); };
+        bool operator==(Fixed other) const { return this->raw == other.raw; };
+        bool operator!=(Fixed other) const { return this->raw != other.raw; };
+};
+
+// y = gain * x + offset with the coefficients computed once from a calibration.
+// gain keeps FIXED_GAIN_FRAC fractional bits so small slopes (volts per ADC
+// count) stay precise, it must stay below 128 in magnitude.
+class FixedLinear {
+    public:
+        // Maps [inMin, inMax] onto [outMin, outMax], like mapfloat()
+        static FixedLinear map(float inMin, float inMax, float outMin, float outMax){
+            FixedLinear l;
+            float gain = (outMax - outMin) / (inMax - inMin);
+            l.gain = (int32_t) (gain * (1L << FIXED_GAIN_FRAC) + (gain >= 0 ? 0.5f : -0.5f));
+            l.offset = Fixed::fromFloat(outMin - inMin * gain);
+            return l;
+        };
+
+        // x has frac fractional bits
+        Fixed apply(int32_t x, uint8_t frac) const {
+            return Fixed::fromRaw((int32_t) (((int64_t) x * this->gain) >> (FIXED_GAIN_FRAC + frac - FIXED_FRAC))) + this->offset;
+        };
+
+        // Gain only, for differences such as a noise amplitude
+        Fixed scale(int32_t x, uint8_t frac) const {
+            return Fixed::fromRaw((int32_t) (((int64_t) x * this->gain) >> (FIXED_GAIN_FRAC + frac - FIXED_FRAC)));
+        };
+
+        int32_t gain = 0; // Q8.24
+        Fixed offset = Fixed::fromRaw(0);
+};
+
+#endif
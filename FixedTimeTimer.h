@@ -40,20 +40,23 @@ class FixedTimeTimer : public Timer  {
           
           return res;
         }
-    private:
-        unsigned long computeTime(){
+
+        // Seconds from now until the next occurrence of startAt (second of the day).
+        // When startAt is the current second the next day is returned.
+        static unsigned long secondsUntil(unsigned int startAt){
             tm* timeObj = get_localtime();
-            unsigned long nextTriggerSec = 0;
-            unsigned long currentTimeSec = timeToSec(timeObj->tm_hour, timeObj->tm_min);
-            if (startAt < currentTimeSec ) {
+            unsigned long currentTimeSec = timeToSec(timeObj->tm_hour, timeObj->tm_min) + timeObj->tm_sec;
+            if (startAt <= currentTimeSec ) {
               //for example it is 14h and should start at 7h
-              nextTriggerSec = (DAY_S - currentTimeSec) + startAt;
-            }
-            else{
-              //it is 7h should start at 14h
-              nextTriggerSec = startAt - currentTimeSec;
+              return (DAY_S - currentTimeSec) + startAt;
             }
-            return nextTriggerSec;
+            //it is 7h should start at 14h
+            return startAt - currentTimeSec;
+        }
+
+    private:
+        unsigned long computeTime(){
+            return secondsUntil(this->startAt);
         }
         unsigned int startAt = 0; //Second in the day to start at
 };
@@ -0,0 +1,55 @@
+#ifndef FIXED_VECTOR_H
+#define FIXED_VECTOR_H
+
+#include <stddef.h>
+
+// Vector with its storage inline: the capacity is part of the type, so the
+// footprint is sizeof() and filling it never touches the heap. Meant for the
+// small plain structs of the configuration, elements past size() keep their
+// last value.
+//
+//   FixedVector<TableObject, 8> table;
+//   if (!table.push_back(slot))
+//     LOG_ERROR("Too many slots");
+template <typename T, size_t N>
+class FixedVector {
+    public:
+        // False when full, the vector is left unchanged
+        bool push_back(const T &value){
+            if (this->count == N)
+              return false;
+            this->items[this->count++] = value;
+            return true;
+        };
+
+        // False when n is above the capacity, the vector is left unchanged
+        bool resize(size_t n){
+            if (n > N)
+              return false;
+            for (size_t i = this->count; i < n; i++)
+              this->items[i] = T();
+            this->count = n;
+            return true;
+        };
+
+        void clear(){ this->count = 0; };
+
+        size_t size() const { return this->count; };
+        bool empty() const { return this->count == 0; };
+        bool full() const { return this->count == N; };
+        static constexpr size_t capacity(){ return N; };
+
+        T & operator[](size_t i){ return this->items[i]; };
+        const T & operator[](size_t i) const { return this->items[i]; };
+
+        T * begin(){ return this->items; };
+        T * end(){ return this->items + this->count; };
+        const T * begin() const { return this->items; };
+        const T * end() const { return this->items + this->count; };
+
+    private:
+        T items[N] = {};
+        size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <Arduino.h>
+
+// Allocation counts and an exact low-water mark need the umm_malloc full
+// statistics, built with -DUMM_STATS_FULL=1. Without them the low-water mark
+// comes from the sample() points and no allocation is counted.
+#if defined(UMM_STATS_FULL)
+#include <umm_malloc/umm_malloc.h>
+#define HEAP_COUNTS_ALLOCATIONS 1
+#else
+#define HEAP_COUNTS_ALLOCATIONS 0
+#endif
+
+// Heap usage seen by the controller: the current state on each update(), the
+// lowest free heap ever, and around each HTTP request the peak number of bytes
+// it held and the allocations it made.
+class HeapMonitor {
+    public:
+        // Free, largest block and fragmentation, read together
+        void update(){
+            uint16_t maxBlock;
+            ESP.getHeapStats(&this->free, &maxBlock, &this->fragmentation);
+            this->maxBlock = maxBlock;
+            lowWater(this->free);
+        };
+
+        // Cheap reading of the free heap, called where buffers are at their largest
+        void sample(){
+            lowWater(ESP.getFreeHeap());
+        };
+
+        void beginRequest(){
+#if HEAP_COUNTS_ALLOCATIONS
+            // Low point since the previous request (journal, push...), kept before umm's is reset for this one
+            lowWater(umm_free_heap_size_min());
+#endif
+            this->requestStart = ESP.getFreeHeap();
+            this->requestMin = this->requestStart;
+#if HEAP_COUNTS_ALLOCATIONS
+            umm_free_heap_size_min_reset();
+            this->requestAllocations = allocations();
+#endif
+        };
+
+        // Peak bytes held by the request and its allocation count
+        void endRequest(uint32_t &peak, uint32_t &allocationCount){
+            sample();
+#if HEAP_COUNTS_ALLOCATIONS
+            lowWater(umm_free_heap_size_min());
+            allocationCount = allocations() - this->requestAllocations;
+#else
+            allocationCount = 0;
+#endif
+            peak = this->requestStart > this->requestMin ? this->requestStart - this->requestMin : 0;
+        };
+
+        uint32_t getFree(){ return this->free; };
+        uint32_t getMaxBlock(){ return this->maxBlock; };
+        uint8_t getFragmentation(){ return this->fragmentation; };
+        uint32_t getMinFree(){ return this->minFree; };
+
+    private:
+        uint32_t free = 0;
+        uint32_t maxBlock = 0;
+        uint8_t fragmentation = 0;
+        uint32_t minFree = UINT32_MAX;
+        uint32_t requestStart = 0;
+        uint32_t requestMin = UINT32_MAX;
+        uint32_t requestAllocations = 0;
+
+        void lowWater(uint32_t free){
+            if (free < this->minFree)
+              this->minFree = free;
+            if (free < this->requestMin)
+              this->requestMin = free;
+        };
+
+#if HEAP_COUNTS_ALLOCATIONS
+        static uint32_t allocations(){
+            return umm_get_malloc_count() + umm_get_realloc_count();
+        };
+#endif
+};
+
+inline HeapMonitor Heap;
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdint.h>
+#include <time.h>
+#include "Log.h"
+
+#define HISTORY_METRICS 7
+#define HISTORY_MAX_TIERS 3
+#define HISTORY_MAX_BYTES 12288 // Sum of the tier budgets
+#define HISTORY_SAMPLE_S 300 // Period at which App feeds the history
+#define HISTORY_GAP INT16_MIN // No sample in the bucket
+
+#define HISTORY_WATER_TEMPERATURE 0
+#define HISTORY_AMBIENT_TEMPERATURE 1
+#define HISTORY_PH 2
+#define HISTORY_ORP 3
+#define HISTORY_WATER_LEVEL 4
+#define HISTORY_FILTER_PRESSURE 5
+#define HISTORY_PUMP 6
+
+typedef struct {
+  const char * name;
+  int16_t scale; // Stored value is round(value * scale)
+} HistoryMetric;
+
+// Pump is 0/1, its downsampled buckets hold the duty cycle
+static const HistoryMetric historyMetrics[HISTORY_METRICS] = {
+  {"water_temperature", 100},
+  {"ambient_temperature", 100},
+  {"ph", 100},
+  {"orp", 10},
+  {"water_level", 10},
+  {"filter_pressure", 100},
+  {"pump", 1000},
+};
+
+typedef struct {
+  uint32_t period; // Seconds per sample
+  uint16_t budget; // Bytes of RAM for the samples
+} HistoryTierConfig;
+
+// One sample of every metric, fixed-point
+typedef struct {
+  int16_t values[HISTORY_METRICS];
+} HistoryRow;
+
+// Ring of rows, one per period-aligned bucket. Samples added within a
+// bucket are averaged, the row is written when a later bucket starts.
+// Row times are implicit: the newest row is lastBucket.
+class HistoryTier {
+    public:
+        ~HistoryTier(){
+            delete[] this->rows;
+        };
+
+        bool begin(const HistoryTierConfig &config){
+            this->period = config.period;
+            this->capacity = config.budget / sizeof(HistoryRow);
+            if (this->period == 0 || this->capacity == 0)
+              return false;
+            delete[] this->rows;
+            this->rows = new HistoryRow[this->capacity];
+            this->count = 0;
+            this->head = 0;
+            this->accCount = 0;
+            return true;
+        };
+
+        void add(time_t time, const float values[HISTORY_METRICS]){
+            uint32_t bucket = time / this->period;
+            if (this->accCount > 0 && bucket != this->accBucket)
+              flush();
+
+            this->accBucket = bucket;
+            this->accCount++;
+            for (uint8_t m = 0; m < HISTORY_METRICS; m++){
+              if (isnan(values[m]))
+                continue;
+              this->accSum[m] += lroundf(values[m] * historyMetrics[m].scale);
+              this->accSamples[m]++;
+            }
+        };
+
+        // Calls fn(time, value) for each row of metric in [from, to], oldest first,
+        // the bucket being accumulated comes last. value is HISTORY_GAP when missing
+        template <typename F>
+        void forEach(uint8_t metric, time_t from, time_t to, F fn) const {
+            for (uint16_t i = 0; i < this->count; i++){
+              time_t time = (time_t) (this->lastBucket - (this->count - 1 - i)) * this->period;
+              if (time < from)
+                continue;
+              if (time > to)
+                return;
+              fn(time, this->rows[(this->head + this->capacity - this->count + i) % this->capacity].values[metric]);
+            }
+            if (this->accCount > 0){
+              time_t time = (time_t) this->accBucket * this->period;
+              if (time >= from && time <= to)
+                fn(time, average(metric));
+            }
+        };
+
+        // Time of the oldest row, 0 when empty
+        time_t oldest() const {
+            if (this->count == 0)
+              return this->accCount > 0 ? (time_t) this->accBucket * this->period : 0;
+            return (time_t) (this->lastBucket - (this->count - 1)) * this->period;
+        };
+
+        uint32_t getPeriod() const { return this->period; };
+        uint16_t getCapacity() const { return this->capacity; };
+        uint16_t size() const { return this->count; };
+        size_t bytes() const { return this->capacity * sizeof(HistoryRow); };
+
+    private:
+        HistoryRow * rows = nullptr;
+        uint32_t period = 0;
+        uint16_t capacity = 0;
+        uint16_t count = 0;
+        uint16_t head = 0; // Next row written
+        uint32_t lastBucket = 0;
+        uint32_t accBucket = 0;
+        uint16_t accCount = 0;
+        int32_t accSum[HISTORY_METRICS] = {};
+        uint16_t accSamples[HISTORY_METRICS] = {};
+
+        int16_t average(uint8_t metric) const {
+            if (this->accSamples[metric] == 0)
+              return HISTORY_GAP;
+            int32_t n = this->accSamples[metric];
+            int32_t sum = this->accSum[metric];
+            return (int16_t) ((sum + (sum >= 0 ? n / 2 : -n / 2)) / n);
+        };
+
+        void push(const HistoryRow &row){
+            this->rows[this->head] = row;
+            this->head = (this->head + 1) % this->capacity;
+            if (this->count < this->capacity)
+              this->count++;
+        };
+
+        void flush(){
+            // Clock went backwards: the newest row already covers this time
+            if (this->count > 0 && this->accBucket <= this->lastBucket){
+              reset();
+              return;
+            }
+
+            if (this->count > 0){
+              HistoryRow gap;
+              for (uint8_t m = 0; m < HISTORY_METRICS; m++)
+                gap.values[m] = HISTORY_GAP;
+              uint32_t missing = this->accBucket - this->lastBucket - 1;
+              if (missing > this->capacity)
+                missing = this->capacity;
+              while (missing--)
+                push(gap);
+            }
+
+            HistoryRow row;
+            for (uint8_t m = 0; m < HISTORY_METRICS; m++)
+              row.values[m] = average(m);
+            push(row);
+            this->lastBucket = this->accBucket;
+            reset();
+        };
+
+        void reset(){
+            this->accCount = 0;
+            for (uint8_t m = 0; m < HISTORY_METRICS; m++){
+              this->accSum[m] = 0;
+              this->accSamples[m] = 0;
+            }
+        };
+};
+
+// Every sample goes to all tiers, each one averages it over its own period
+class History {
+    public:
+        bool begin(const HistoryTierConfig * configs, uint8_t tierCount){
+            size_t total = 0;
+            for (uint8_t i = 0; i < tierCount; i++){
+              if (configs[i].budget < sizeof(HistoryRow)){
+                LOG_ERROR("History tier %u: budget below one sample (%u bytes)", i, sizeof(HistoryRow));
+                return false;
+              }
+              if (i > 0 && configs[i].period <= configs[i - 1].period){
+                LOG_ERROR("History tier %u: period must be longer than the previous tier", i);
+                return false;
+              }
+              total += configs[i].budget;
+            }
+            if (tierCount > HISTORY_MAX_TIERS || total > HISTORY_MAX_BYTES){
+              LOG_ERROR("History: %u tiers / %u bytes, limit is %u tiers / %u bytes", tierCount, total, HISTORY_MAX_TIERS, HISTORY_MAX_BYTES);
+              return false;
+            }
+
+            this->tierCount = 0;
+            for (uint8_t i = 0; i < tierCount; i++){
+              if (!this->tiers[i].begin(configs[i]))
+                return false;
+              this->tierCount++;
+              LOG_INFO("History tier %u: %lus x %u samples (%lu s) in %u bytes", i, this->tiers[i].getPeriod(),
+                this->tiers[i].getCapacity(), this->tiers[i].getPeriod() * this->tiers[i].getCapacity(), this->tiers[i].bytes());
+            }
+            return true;
+        };
+
+        void add(time_t time, const float values[HISTORY_METRICS]){
+            for (uint8_t i = 0; i < this->tierCount; i++)
+              this->tiers[i].add(time, values);
+        };
+
+        // Finest tier still holding data at from, the coarsest one otherwise
+        uint8_t selectTier(time_t from) const {
+            for (uint8_t i = 0; i < this->tierCount; i++){
+              time_t oldest = this->tiers[i].oldest();
+              if (oldest != 0 && oldest <= from)
+                return i;
+            }
+            return this->tierCount > 0 ? this->tierCount - 1 : 0;
+        };
+
+        // Fixed-point row of values, out of range values are clamped
+        static void pack(const float values[HISTORY_METRICS], HistoryRow &row){
+            for (uint8_t m = 0; m < HISTORY_METRICS; m++){
+              if (isnan(values[m])){
+                row.values[m] = HISTORY_GAP;
+                continue;
+              }
+              long value = lroundf(values[m] * historyMetrics[m].scale);
+              row.values[m] = value > INT16_MAX ? INT16_MAX : value <= INT16_MIN ? INT16_MIN + 1 : value;
+            }
+        };
+
+        static int findMetric(const String &name){
+            for (uint8_t m = 0; m < HISTORY_METRICS; m++)
+              if (name == historyMetrics[m].name)
+                return m;
+            return -1;
+        };
+
+        const HistoryTier & tier(uint8_t index) const { return this->tiers[index]; };
+        uint8_t size() const { return this->tierCount; };
+
+        size_t bytes() const {
+            size_t total = 0;
+            for (uint8_t i = 0; i < this->tierCount; i++)
+              total += this->tiers[i].bytes();
+            return total;
+        };
+
+    private:
+        HistoryTier tiers[HISTORY_MAX_TIERS];
+        uint8_t tierCount = 0;
+};
+
+#endif
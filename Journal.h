@@ -0,0 +1,327 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+#include <stddef.h>
+#include "config.h"
+#include "timer.h"
+#include "History.h"
+#include "Log.h"
+
+#define JOURNAL_DIR "/journal"
+#define JOURNAL_RECORD_MAGIC 0xA55A
+#define JOURNAL_PAGE_BYTES 256 // LittleFS program size, writes are batched to it
+#define JOURNAL_BATCH (JOURNAL_PAGE_BYTES / sizeof(JournalRecord))
+#define JOURNAL_SEGMENT_BYTES 4096
+#define JOURNAL_MAX_RAW_SEGMENTS 6 // ~3.5 days at 5 min
+#define JOURNAL_MAX_COMPACT_SEGMENTS 4 // ~28 days at 1 h
+#define JOURNAL_COMPACT_PERIOD 3600
+#define JOURNAL_RAW 0
+#define JOURNAL_COMPACT 1
+
+// 24 bytes, no padding
+typedef struct {
+  uint32_t time;
+  HistoryRow row;
+  uint16_t magic;
+  uint32_t crc; // Over every field above
+} JournalRecord;
+
+typedef struct {
+  uint32_t first; // Oldest segment sequence
+  uint32_t next; // Sequence of the segment being appended, first == next when empty
+  uint32_t size; // Bytes in segment next
+} JournalLevel;
+
+// Append-only sample journal in numbered segment files, one directory level
+// per resolution: raw samples ("r" files) and their hourly averages ("c").
+// Samples are kept in RAM until a flash page worth of them is ready. When
+// there are too many raw segments the oldest is compacted into hourly
+// records and removed, compacted segments beyond their limit are dropped.
+// An hour cut by a segment boundary is compacted whole with the older
+// segment, its raw records left in the newer one are skipped from then on.
+class Journal {
+    public:
+        bool begin(){
+            if (!LittleFS.exists(JOURNAL_DIR))
+              LittleFS.mkdir(JOURNAL_DIR);
+
+            for (uint8_t level = 0; level < 2; level++)
+              this->levels[level] = {0, 0, 0};
+
+            bool found[2] = {false, false};
+            Dir dir = LittleFS.openDir(JOURNAL_DIR);
+            while (dir.next()) {
+              String name = dir.fileName();
+              if (name.length() < 2 || (name[0] != 'r' && name[0] != 'c'))
+                continue;
+              uint8_t level = name[0] == 'r' ? JOURNAL_RAW : JOURNAL_COMPACT;
+              uint32_t seq = strtoul(name.c_str() + 1, nullptr, 16);
+              JournalLevel &l = this->levels[level];
+              if (!found[level] || seq < l.first)
+                l.first = seq;
+              if (!found[level] || seq >= l.next){
+                l.next = seq;
+                l.size = dir.fileSize();
+              }
+              found[level] = true;
+            }
+
+            // A partial last record (power cut during a write) is left behind, appends restart in a new segment
+            for (uint8_t level = 0; level < 2; level++){
+              JournalLevel &l = this->levels[level];
+              if (found[level] && (l.size % sizeof(JournalRecord) != 0 || l.size >= JOURNAL_SEGMENT_BYTES)){
+                l.next++;
+                l.size = 0;
+              }
+            }
+
+            this->compactedUntil = lastCompactedBucket() + 1;
+
+            LOG_INFO("Journal: %u raw and %u compacted segments", segments(JOURNAL_RAW), segments(JOURNAL_COMPACT));
+            return true;
+        };
+
+        void append(time_t time, const HistoryRow &row){
+            JournalRecord &record = this->batch[this->pending++];
+            seal(record, time, row);
+            if (this->pending == JOURNAL_BATCH)
+              flush();
+        };
+
+        // Writes the batch even when it is not a full page, e.g. before a reboot
+        void flush(){
+            if (this->pending == 0)
+              return;
+            write(JOURNAL_RAW, this->batch, this->pending);
+            this->pending = 0;
+        };
+
+        // Calls fn(record) for records in [from, to], compacted ones first then raw ones then
+        // the unwritten batch. Segments are read one at a time through a small buffer.
+        // Invalid records are skipped, they are counted once when their segment is compacted
+        template <typename F>
+        void forEach(time_t from, time_t to, F fn){
+            for (uint8_t level : {JOURNAL_COMPACT, JOURNAL_RAW}){
+              // Raw records of an hour already compacted, see compact()
+              time_t skipBefore = level == JOURNAL_RAW ? (time_t) this->compactedUntil * JOURNAL_COMPACT_PERIOD : 0;
+              JournalLevel &l = this->levels[level];
+              for (uint32_t seq = l.first; seq <= l.next; seq++){
+                char name[24];
+                segmentName(level, seq, name);
+                File file = LittleFS.open(name, "r");
+                if (!file)
+                  continue;
+
+                JournalRecord records[8];
+                size_t n;
+                while ((n = file.read((uint8_t *) records, sizeof(records)) / sizeof(JournalRecord)) > 0){
+                  for (size_t i = 0; i < n; i++){
+                    if (!valid(records[i]) || (time_t) records[i].time < skipBefore)
+                      continue;
+                    if (records[i].time >= from && records[i].time <= to)
+                      fn(records[i]);
+                  }
+                }
+                file.close();
+              }
+            }
+
+            for (uint8_t i = 0; i < this->pending; i++)
+              if (this->batch[i].time >= from && this->batch[i].time <= to)
+                fn(this->batch[i]);
+        };
+
+        uint32_t segments(uint8_t level){
+            const JournalLevel &l = this->levels[level];
+            return l.next - l.first + (l.size > 0 ? 1 : 0);
+        };
+
+        // Flash bytes written since boot
+        unsigned long getBytesWritten(){ return this->bytesWritten; };
+
+        // Flash bytes written during the previous and the running UTC day
+        unsigned long getBytesPreviousDay(){ return this->bytesPreviousDay; };
+        unsigned long getBytesToday(){ return this->bytesToday; };
+
+        unsigned long getCrcErrors(){ return this->crcErrors; };
+        uint8_t getPending(){ return this->pending; };
+
+    private:
+        JournalLevel levels[2];
+        JournalRecord batch[JOURNAL_BATCH];
+        uint8_t pending = 0;
+        unsigned long bytesWritten = 0;
+        unsigned long bytesToday = 0;
+        unsigned long bytesPreviousDay = 0;
+        uint32_t today = 0;
+        unsigned long crcErrors = 0;
+        uint32_t compactedUntil = 0; // First hour bucket not compacted yet
+
+        static void segmentName(uint8_t level, uint32_t seq, char * name){
+            snprintf(name, 24, JOURNAL_DIR "/%c%08x", level == JOURNAL_RAW ? 'r' : 'c', (unsigned) seq);
+        };
+
+        static void seal(JournalRecord &record, time_t time, const HistoryRow &row){
+            record.time = time;
+            record.row = row;
+            record.magic = JOURNAL_RECORD_MAGIC;
+            record.crc = ConfigurationFactory_crc32(&record, offsetof(JournalRecord, crc));
+        };
+
+        static bool valid(const JournalRecord &record){
+            return record.magic == JOURNAL_RECORD_MAGIC && record.crc == ConfigurationFactory_crc32(&record, offsetof(JournalRecord, crc));
+        };
+
+        void accountWrite(size_t bytes){
+            uint32_t day = get_time() / 86400;
+            if (day != this->today){
+              this->bytesPreviousDay = day == this->today + 1 ? this->bytesToday : 0;
+              this->bytesToday = 0;
+              this->today = day;
+            }
+            this->bytesWritten += bytes;
+            this->bytesToday += bytes;
+        };
+
+        void write(uint8_t level, const JournalRecord * records, size_t count){
+            JournalLevel &l = this->levels[level];
+            size_t bytes = count * sizeof(JournalRecord);
+            if (l.size > 0 && l.size + bytes > JOURNAL_SEGMENT_BYTES)
+              rotate(level);
+
+            char name[24];
+            segmentName(level, l.next, name);
+            File file = LittleFS.open(name, "a");
+            if (!file){
+              LOG_ERROR("Journal: cannot open %s", name);
+              return;
+            }
+            size_t written = file.write((const uint8_t *) records, bytes);
+            file.close();
+            l.size += written;
+            accountWrite(written);
+        };
+
+        void rotate(uint8_t level){
+            JournalLevel &l = this->levels[level];
+            l.next++;
+            l.size = 0;
+
+            uint32_t limit = level == JOURNAL_RAW ? JOURNAL_MAX_RAW_SEGMENTS : JOURNAL_MAX_COMPACT_SEGMENTS;
+            while (l.next - l.first >= limit){
+              if (level == JOURNAL_RAW)
+                compact(l.first);
+              char name[24];
+              segmentName(level, l.first, name);
+              LittleFS.remove(name);
+              l.first++;
+            }
+        };
+
+        // Bucket of the newest valid compacted record, -1 (wrapping to 0 above) when there is none
+        uint32_t lastCompactedBucket(){
+            const JournalLevel &l = this->levels[JOURNAL_COMPACT];
+            for (uint32_t seq = l.next + 1; seq-- > l.first;){
+              char name[24];
+              segmentName(JOURNAL_COMPACT, seq, name);
+              File file = LittleFS.open(name, "r");
+              if (!file)
+                continue;
+              bool found = false;
+              uint32_t last = 0;
+              JournalRecord record;
+              while (file.read((uint8_t *) &record, sizeof(record)) == sizeof(record)){
+                if (valid(record)){
+                  last = record.time / JOURNAL_COMPACT_PERIOD;
+                  found = true;
+                }
+              }
+              file.close();
+              if (found)
+                return last;
+            }
+            return (uint32_t) -1;
+        };
+
+        // Hourly averages of a raw segment, appended to the compacted level. The last hour
+        // usually goes on in the next segment: its records there are read too, so the hour
+        // gets a single average, and compactedUntil keeps them from being used again
+        void compact(uint32_t seq){
+            char name[24];
+            segmentName(JOURNAL_RAW, seq, name);
+            File file = LittleFS.open(name, "r");
+            if (!file)
+              return;
+
+            JournalRecord out[JOURNAL_BATCH];
+            size_t outCount = 0;
+            int32_t sum[HISTORY_METRICS] = {};
+            uint16_t samples[HISTORY_METRICS] = {};
+            uint32_t bucket = 0;
+            bool open = false;
+
+            auto emit = [&](){
+              HistoryRow row;
+              for (uint8_t m = 0; m < HISTORY_METRICS; m++){
+                row.values[m] = samples[m] ? (int16_t) (sum[m] / samples[m]) : HISTORY_GAP;
+                sum[m] = 0;
+                samples[m] = 0;
+              }
+              seal(out[outCount++], (time_t) bucket * JOURNAL_COMPACT_PERIOD, row);
+              if (outCount == JOURNAL_BATCH){
+                write(JOURNAL_COMPACT, out, outCount);
+                outCount = 0;
+              }
+            };
+
+            auto add = [&](const JournalRecord &record){
+              for (uint8_t m = 0; m < HISTORY_METRICS; m++){
+                if (record.row.values[m] == HISTORY_GAP)
+                  continue;
+                sum[m] += record.row.values[m];
+                samples[m]++;
+              }
+            };
+
+            JournalRecord record;
+            while (file.read((uint8_t *) &record, sizeof(record)) == sizeof(record)){
+              if (!valid(record)){
+                this->crcErrors++;
+                continue;
+              }
+              uint32_t recordBucket = record.time / JOURNAL_COMPACT_PERIOD;
+              if (recordBucket < this->compactedUntil)
+                continue; // Compacted with the previous segment
+              if (open && recordBucket != bucket)
+                emit();
+              bucket = recordBucket;
+              open = true;
+              add(record);
+            }
+            file.close();
+
+            if (open){
+              segmentName(JOURNAL_RAW, seq + 1, name);
+              File next = LittleFS.open(name, "r");
+              if (next){
+                while (next.read((uint8_t *) &record, sizeof(record)) == sizeof(record)){
+                  if (!valid(record))
+                    continue; // Counted when that segment is compacted
+                  if (record.time / JOURNAL_COMPACT_PERIOD != bucket)
+                    break;
+                  add(record);
+                }
+                next.close();
+              }
+              emit();
+              this->compactedUntil = bucket + 1;
+            }
+            if (outCount > 0)
+              write(JOURNAL_COMPACT, out, outCount);
+        };
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+#define LATENCY_BUCKETS 12
+
+// Upper bounds in microseconds, the last bucket takes everything above
+static const uint32_t latencyBounds[LATENCY_BUCKETS - 1] = {50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000, 500000};
+
+// Fixed-bucket histogram of durations, measured with the CPU cycle counter.
+// The counter wraps after 53 s at 80 MHz, far above anything timed here.
+//
+//   uint32_t start = ESP.getCycleCount();
+//   work();
+//   histogram.recordSince(start);
+class LatencyHistogram {
+    public:
+        void record(uint32_t us){
+            uint8_t bucket = 0;
+            while (bucket < LATENCY_BUCKETS - 1 && us > latencyBounds[bucket])
+              bucket++;
+            this->counts[bucket]++;
+            this->count++;
+            this->sum += us;
+            if (us > this->max)
+              this->max = us;
+        };
+
+        // Records the time elapsed since the start cycle count and returns the
+        // current one, so consecutive phases can be chained
+        uint32_t recordSince(uint32_t start){
+            uint32_t now = ESP.getCycleCount();
+            record((now - start) / ESP.getCpuFreqMHz());
+            return now;
+        };
+
+        // Not cumulative, bucket i holds the durations in (bound i-1, bound i]
+        const uint32_t * getCounts() const { return this->counts; };
+        uint32_t getCount() const { return this->count; };
+        uint64_t getSum() const { return this->sum; };
+        uint32_t getMax() const { return this->max; };
+
+    private:
+        uint32_t counts[LATENCY_BUCKETS] = {};
+        uint32_t count = 0;
+        uint64_t sum = 0; // us
+        uint32_t max = 0; // us
+};
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <type_traits>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Messages above this level are removed by the preprocessor, arguments included
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_BYTES 2048
+#define LOG_MAX_ARGS 8
+#define LOG_MAX_RECORD 96 // Header and arguments, the arguments that do not fit are dropped
+#define LOG_MAX_STRING 32 // Longer string arguments are truncated
+#define LOG_LINE_BYTES 128 // Formatted line, fits the UART FIFO
+
+#define LOG_ARG_INT 0
+#define LOG_ARG_UINT 1
+#define LOG_ARG_FLOAT 2
+#define LOG_ARG_STRING 3 // Length byte then the characters
+
+typedef struct {
+  uint8_t size; // Header and arguments, first so the ring can skip records
+  uint8_t level;
+  uint16_t types; // LOG_ARG_* of argument i in bits 2i and 2i+1
+  uint32_t time; // millis()
+  PGM_P format;
+  uint8_t argc;
+} LogHeader;
+
+#define LOG_AT(level, format, ...) do { if (Log.enabled(level)) Log.add(level, PSTR(format), ##__VA_ARGS__); } while (0)
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(format, ...) LOG_AT(LOG_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(format, ...) LOG_AT(LOG_LEVEL_WARN, format, ##__VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(format, ...) LOG_AT(LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(format, ...) LOG_AT(LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
+
+// Binary log ring. A record keeps the printf format pointer (in flash) and
+// the raw arguments, the text is only produced when the log is read through
+// print() or streamed to Serial. Formats take the usual conversions, length
+// modifiers are ignored as every number is stored on 32 bits. The oldest
+// records are overwritten when the ring is full.
+class LogBuffer {
+    public:
+        bool enabled(uint8_t level) const { return level <= this->level; };
+
+        template <typename... Args>
+        void add(uint8_t level, PGM_P format, const Args &... args){
+            uint8_t record[LOG_MAX_RECORD];
+            LogHeader header = {0, level, 0, (uint32_t) millis(), format, 0};
+            size_t length = sizeof(LogHeader);
+            (void) (pack(record, length, header, args) && ...);
+            header.size = length;
+            memcpy(record, &header, sizeof(LogHeader));
+            push(record, length);
+        };
+
+        // Writes the records from sequence since on, one line each prefixed by its
+        // sequence. Returns the sequence of the next record
+        uint32_t print(Print &out, uint32_t since, uint8_t maxLevel = LOG_LEVEL_DEBUG){
+            forEach(since, [&](uint32_t seq, const uint8_t * record){
+              if (record[offsetof(LogHeader, level)] > maxLevel)
+                return;
+              char text[LOG_LINE_BYTES];
+              line(record, text);
+              out.print(seq);
+              out.print(' ');
+              out.print(text);
+            });
+            return this->next;
+        };
+
+        // Writes pending records to the serial port as long as they fit in its FIFO,
+        // called from loop() so logging never waits for the UART
+        void stream(HardwareSerial &serial){
+            if (this->serialLevel == LOG_LEVEL_NONE){
+              this->serialSeq = this->next;
+              this->serialPos = this->head;
+              return;
+            }
+            uint8_t record[LOG_MAX_RECORD];
+            while (this->serialSeq != this->next){
+              read(this->serialPos, record);
+              if (record[offsetof(LogHeader, level)] <= this->serialLevel){
+                char text[LOG_LINE_BYTES];
+                size_t length = line(record, text);
+                if ((size_t) serial.availableForWrite() < length)
+                  return;
+                serial.write((const uint8_t *) text, length);
+              }
+              this->serialPos = (this->serialPos + record[0]) % LOG_RING_BYTES;
+              this->serialSeq++;
+            }
+        };
+
+        // Records stored at or below level, records above are not even packed
+        void setLevel(uint8_t level){ this->level = level; };
+        uint8_t getLevel(){ return this->level; };
+        // Records streamed to Serial, LOG_LEVEL_NONE turns streaming off
+        void setSerialLevel(uint8_t level){ this->serialLevel = level; };
+        uint8_t getSerialLevel(){ return this->serialLevel; };
+
+        static const char * levelName(uint8_t level){
+            static const char * const names[] = {"none", "error", "warn", "info", "debug"};
+            return level <= LOG_LEVEL_DEBUG ? names[level] : "?";
+        };
+
+        // Accepts a name or a number, -1 when invalid
+        static int parseLevel(const String &value){
+            for (uint8_t level = LOG_LEVEL_NONE; level <= LOG_LEVEL_DEBUG; level++)
+              if (value.equalsIgnoreCase(levelName(level)) || value == String(level))
+                return level;
+            return -1;
+        };
+
+        // Sequence of the oldest record kept and of the next one
+        uint32_t getFirst(){ return this->first; };
+        uint32_t getNext(){ return this->next; };
+        // Records overwritten before they reached Serial
+        unsigned long getSerialMissed(){ return this->serialMissed; };
+        size_t getUsed(){ return this->used; };
+
+    private:
+        uint8_t ring[LOG_RING_BYTES];
+        uint16_t head = 0; // Next byte written
+        uint16_t tail = 0; // Oldest record
+        uint16_t used = 0;
+        uint32_t first = 0;
+        uint32_t next = 0;
+        uint32_t serialSeq = 0;
+        uint16_t serialPos = 0;
+        unsigned long serialMissed = 0;
+        uint8_t level = LOG_COMPILE_LEVEL;
+        uint8_t serialLevel = LOG_COMPILE_LEVEL;
+
+        // False once the record is full, the remaining arguments are dropped
+        template <typename T>
+        static bool pack(uint8_t * record, size_t &length, LogHeader &header, const T &value){
+            if (header.argc == LOG_MAX_ARGS)
+              return false;
+            if constexpr (std::is_same<T, String>::value){
+              return packString(record, length, header, value.c_str(), false);
+            }
+            else if constexpr (std::is_convertible<const T &, const __FlashStringHelper *>::value){
+              return packString(record, length, header, reinterpret_cast<PGM_P>(static_cast<const __FlashStringHelper *>(value)), true);
+            }
+            else if constexpr (std::is_convertible<const T &, const char *>::value){
+              const char * string = value;
+              return packString(record, length, header, string ? string : "(null)", false);
+            }
+            else if constexpr (std::is_floating_point<T>::value){
+              float number = value;
+              uint32_t word;
+              memcpy(&word, &number, sizeof(word));
+              return packWord(record, length, header, LOG_ARG_FLOAT, word);
+            }
+            else if constexpr (std::is_integral<T>::value || std::is_enum<T>::value){
+              bool isUnsigned = std::is_integral<T>::value && !std::is_signed<T>::value;
+              return packWord(record, length, header, isUnsigned ? LOG_ARG_UINT : LOG_ARG_INT, (uint32_t) value);
+            }
+            else {
+              static_assert(sizeof(T) == 0, "Unsupported log argument type");
+              return false;
+            }
+        };
+
+        static bool packWord(uint8_t * record, size_t &length, LogHeader &header, uint8_t type, uint32_t word){
+            if (length + sizeof(word) > LOG_MAX_RECORD)
+              return false;
+            memcpy(record + length, &word, sizeof(word));
+            length += sizeof(word);
+            header.types |= type << (2 * header.argc++);
+            return true;
+        };
+
+        static bool packString(uint8_t * record, size_t &length, LogHeader &header, const char * string, bool flash){
+            if (length + 1 > LOG_MAX_RECORD)
+              return false;
+            size_t n = flash ? strlen_P(string) : strlen(string);
+            if (n > LOG_MAX_STRING)
+              n = LOG_MAX_STRING;
+            if (n > LOG_MAX_RECORD - length - 1)
+              n = LOG_MAX_RECORD - length - 1;
+            record[length] = n;
+            if (flash)
+              memcpy_P(record + length + 1, string, n);
+            else
+              memcpy(record + length + 1, string, n);
+            length += 1 + n;
+            header.types |= LOG_ARG_STRING << (2 * header.argc++);
+            return true;
+        };
+
+        void push(const uint8_t * record, size_t size){
+            while ((size_t) (LOG_RING_BYTES - this->used) < size)
+              drop();
+            for (size_t i = 0; i < size; i++)
+              this->ring[(this->head + i) % LOG_RING_BYTES] = record[i];
+            this->head = (this->head + size) % LOG_RING_BYTES;
+            this->used += size;
+            this->next++;
+        };
+
+        void drop(){
+            uint8_t size = this->ring[this->tail];
+            if (this->serialSeq == this->first && this->serialSeq != this->next){
+              if (this->serialLevel != LOG_LEVEL_NONE)
+                this->serialMissed++;
+              this->serialSeq++;
+              this->serialPos = (this->tail + size) % LOG_RING_BYTES;
+            }
+            this->tail = (this->tail + size) % LOG_RING_BYTES;
+            this->used -= size;
+            this->first++;
+        };
+
+        void read(uint16_t pos, uint8_t * record) const {
+            uint8_t size = this->ring[pos];
+            for (uint8_t i = 0; i < size; i++)
+              record[i] = this->ring[(pos + i) % LOG_RING_BYTES];
+        };
+
+        template <typename F>
+        void forEach(uint32_t since, F fn) const {
+            uint8_t record[LOG_MAX_RECORD];
+            uint16_t pos = this->tail;
+            for (uint32_t seq = this->first; seq != this->next; seq++){
+              read(pos, record);
+              pos = (pos + record[0]) % LOG_RING_BYTES;
+              if ((int32_t) (seq - since) >= 0)
+                fn(seq, record);
+            }
+        };
+
+        // "[seconds.millis] L message\n", truncated to LOG_LINE_BYTES
+        static size_t line(const uint8_t * record, char * text){
+            LogHeader header;
+            memcpy(&header, record, sizeof(LogHeader));
+            int length = snprintf(text, LOG_LINE_BYTES, "[%lu.%03lu] %c ", (unsigned long) header.time / 1000,
+              (unsigned long) header.time % 1000, "-EWID"[header.level <= LOG_LEVEL_DEBUG ? header.level : 0]);
+            length += format(record, text + length, LOG_LINE_BYTES - length - 1);
+            text[length++] = '\n';
+            text[length] = 0;
+            return length;
+        };
+
+        // printf of the record arguments, one conversion at a time
+        static size_t format(const uint8_t * record, char * out, size_t size){
+            LogHeader header;
+            memcpy(&header, record, sizeof(LogHeader));
+            const uint8_t * arg = record + sizeof(LogHeader);
+            uint8_t index = 0;
+            size_t length = 0;
+            PGM_P p = header.format;
+            char c;
+
+            while (length + 1 < size && (c = pgm_read_byte(p++)) != 0){
+              if (c != '%'){
+                out[length++] = c;
+                continue;
+              }
+
+              char spec[12] = "%";
+              uint8_t n = 1;
+              while ((c = pgm_read_byte(p)) != 0 && strchr("-+ #0123456789.", c)){
+                if (n < sizeof(spec) - 2)
+                  spec[n++] = c;
+                p++;
+              }
+              while ((c = pgm_read_byte(p)) != 0 && strchr("hlLjzt", c))
+                p++;
+              if (c == 0)
+                break;
+              p++;
+              if (c == '%'){
+                out[length++] = '%';
+                continue;
+              }
+
+              int written;
+              if (index >= header.argc){
+                written = snprintf(out + length, size - length, "?");
+              }
+              else if (((header.types >> (2 * index)) & 3) == LOG_ARG_STRING){
+                char string[LOG_MAX_STRING + 1];
+                uint8_t stringLength = *arg;
+                memcpy(string, arg + 1, stringLength);
+                string[stringLength] = 0;
+                arg += 1 + stringLength;
+                index++;
+                spec[n++] = 's';
+                spec[n] = 0;
+                written = snprintf(out + length, size - length, c == 's' ? spec : "%s", string);
+              }
+              else {
+                uint8_t type = (header.types >> (2 * index)) & 3;
+                uint32_t word;
+                memcpy(&word, arg, sizeof(word));
+                arg += sizeof(word);
+                index++;
+                float number;
+                memcpy(&number, &word, sizeof(number));
+
+                // A number printed with %s falls back to its natural conversion
+                if (c == 's')
+                  c = type == LOG_ARG_FLOAT ? 'g' : type == LOG_ARG_INT ? 'd' : 'u';
+                else if (c == 'p')
+                  c = 'x';
+                spec[n++] = c;
+                spec[n] = 0;
+
+                if (strchr("fFeEgGaA", c))
+                  written = snprintf(out + length, size - length, spec, type == LOG_ARG_FLOAT ? (double) number : type == LOG_ARG_INT ? (double) (int32_t) word : (double) word);
+                else if (strchr("dic", c))
+                  written = snprintf(out + length, size - length, spec, type == LOG_ARG_FLOAT ? (int) number : (int) (int32_t) word);
+                else
+                  written = snprintf(out + length, size - length, spec, type == LOG_ARG_FLOAT ? (unsigned) number : (unsigned) word);
+              }
+
+              if (written > 0)
+                length = length + written < size ? length + written : size - 1;
+            }
+
+            out[length] = 0;
+            return length;
+        };
+};
+
+inline LogBuffer Log;
+
+#endif
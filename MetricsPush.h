@@ -0,0 +1,259 @@
+#ifndef METRICS_PUSH_H
+#define METRICS_PUSH_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <functional>
+#include <new>
+#include "mini_prom_client.h"
+#include "LatencyHistogram.h"
+#include "timer.h"
+#include "Log.h"
+
+#ifndef METRICS_PUSH
+#define METRICS_PUSH 0 // 1 sends the metrics to METRICS_PUSH_HOST on top of /api/prometheus
+#endif
+#ifndef METRICS_PUSH_HOST
+#define METRICS_PUSH_HOST "192.168.1.2"
+#endif
+#ifndef METRICS_PUSH_PORT
+#define METRICS_PUSH_PORT 8428
+#endif
+#ifndef METRICS_PUSH_PATH
+#define METRICS_PUSH_PATH "/api/v1/import/prometheus" // Takes timestamped text exposition
+#endif
+#ifndef METRICS_PUSH_TIMESTAMPS
+#define METRICS_PUSH_TIMESTAMPS 1 // 0 for a Pushgateway, which refuses timestamped samples
+#endif
+#ifndef METRICS_PUSH_SAMPLE_S
+#define METRICS_PUSH_SAMPLE_S 30 // One batch captured every
+#endif
+#ifndef METRICS_PUSH_INTERVAL_S
+#define METRICS_PUSH_INTERVAL_S 60 // Queued batches sent every
+#endif
+#ifndef METRICS_PUSH_QUEUE
+#define METRICS_PUSH_QUEUE 4 // Batches kept across outages, 4 bytes per value of the metrics pass each
+#endif
+#define METRICS_PUSH_CONNECT_MS 500 // Longest connect(), it blocks loop()
+#define METRICS_PUSH_RESPONSE_MS 5000
+
+typedef enum {
+  PUSH_IDLE,
+  PUSH_WAITING // Batch sent, reading the status line
+} PushState;
+
+// Print sink writing each write() as one HTTP chunk to the client
+class ChunkedClientPrint : public Print {
+    public:
+        ChunkedClientPrint(WiFiClient &client) : client(client) {};
+
+        using Print::write;
+
+        size_t write(uint8_t c) override { return write(&c, 1); };
+
+        size_t write(const uint8_t * data, size_t size) override {
+            char prefix[12];
+            int n = snprintf(prefix, sizeof(prefix), "%x\r\n", (unsigned) size);
+            this->client.write((const uint8_t *) prefix, n);
+            this->client.write(data, size);
+            this->client.write((const uint8_t *) "\r\n", 2);
+            return size;
+        };
+
+        void end(){
+            this->client.write((const uint8_t *) "0\r\n\r\n", 5);
+        };
+
+    private:
+        WiFiClient &client;
+};
+
+// Push mode for the metrics of /api/prometheus, for when scrapes over Wi-Fi
+// get lost. Every METRICS_PUSH_SAMPLE_S the metrics pass is run in capture
+// mode into a PromBatch (values only); every METRICS_PUSH_INTERVAL_S the
+// queued batches are POSTed one per request, oldest first, each replayed
+// through the same pass with its own timestamp. A failed push keeps the
+// queue for the next interval; when it is full the oldest batch is dropped
+// and its samples counted. A batch refused with a 4xx is dropped as well,
+// sending it again would not help.
+//
+// The batches are sized by a first pass on the first service(), once every
+// series exists; push is disabled with an error if they do not fit in the heap.
+// Values a later pass could not store (a series added since) are counted as
+// dropped samples.
+//
+// Only connect() blocks, up to METRICS_PUSH_CONNECT_MS. The body is written
+// like a scrape response, the status line is read by later service() calls.
+class MetricsPush {
+    public:
+        typedef std::function<void(MiniPromClient &)> Writer;
+
+        MetricsPush(Writer writer) : writer(writer) {};
+
+        // Once per loop
+        void service(){
+            if (!this->storage && !allocate())
+              return;
+            unsigned long now = millis();
+            if (!this->started || now - this->lastCapture >= METRICS_PUSH_SAMPLE_S * 1000UL) {
+              this->started = true;
+              this->lastCapture = now;
+              capture();
+            }
+
+            if (this->state == PUSH_WAITING)
+              return poll();
+
+            // Right after a success the next batch goes out, a backlog is drained one batch per loop
+            if (this->count > 0 && (this->draining || now - this->lastPush >= METRICS_PUSH_INTERVAL_S * 1000UL)) {
+              this->lastPush = now;
+              send();
+            }
+        };
+
+        uint8_t depth(){ return this->count; };
+        uint16_t getSlots(){ return this->slots; };
+        unsigned long getPushed(){ return this->pushed; };
+        unsigned long getFailures(){ return this->failures; };
+        unsigned long getDroppedSamples(){ return this->droppedSamples; };
+        unsigned long getLastLatency(){ return this->lastLatency; };
+        const LatencyHistogram & getLatency(){ return this->latency; };
+
+    private:
+        Writer writer;
+        WiFiClient client;
+        PromBatch queue[METRICS_PUSH_QUEUE] = {};
+        uint32_t * storage = nullptr; // Values of every batch
+        uint16_t slots = 0; // Per batch
+        bool disabled = false;
+        uint8_t head = 0; // Oldest batch
+        uint8_t count = 0;
+        uint32_t nextSeq = 0;
+        uint32_t sentSeq = 0; // Batch whose response is awaited
+        uint8_t state = PUSH_IDLE;
+        bool started = false;
+        bool draining = false;
+        unsigned long lastCapture = 0; // ms
+        unsigned long lastPush = 0; // ms
+        unsigned long sentAt = 0; // ms
+        uint32_t startCycles = 0; // Push latency, from connect() to the status line
+        char status[13];
+        uint8_t statusLength = 0;
+
+        unsigned long pushed = 0;
+        unsigned long failures = 0;
+        unsigned long droppedSamples = 0;
+        unsigned long lastLatency = 0; // us
+        LatencyHistogram latency;
+
+        bool allocate(){
+            if (this->disabled)
+              return false;
+            PromBatch probe = {};
+            MiniPromClient client(probe);
+            this->writer(client);
+            this->slots = probe.needed;
+            this->storage = new (std::nothrow) uint32_t[METRICS_PUSH_QUEUE * this->slots];
+            if (!this->storage) {
+              LOG_ERROR("Metrics push disabled, no room for %u batches of %u values", METRICS_PUSH_QUEUE, this->slots);
+              this->disabled = true;
+              return false;
+            }
+            for (uint8_t i = 0; i < METRICS_PUSH_QUEUE; i++) {
+              this->queue[i].values = this->storage + i * this->slots;
+              this->queue[i].capacity = this->slots;
+            }
+            LOG_INFO("Metrics push: %u batches of %u values", METRICS_PUSH_QUEUE, this->slots);
+            return true;
+        };
+
+        void capture(){
+            if (this->count == METRICS_PUSH_QUEUE) {
+              this->droppedSamples += this->queue[this->head].samples;
+              pop();
+            }
+            PromBatch &batch = this->queue[(this->head + this->count) % METRICS_PUSH_QUEUE];
+            batch.time = get_time();
+            batch.seq = this->nextSeq++;
+            MiniPromClient client(batch);
+            this->writer(client);
+            if (batch.missing) {
+              LOG_ERROR("Metrics batch needs %u values, sized for %u", batch.needed, batch.capacity);
+              this->droppedSamples += batch.missing;
+            }
+            this->count++;
+        };
+
+        void pop(){
+            this->head = (this->head + 1) % METRICS_PUSH_QUEUE;
+            this->count--;
+        };
+
+        void send(){
+            this->draining = false;
+            this->startCycles = ESP.getCycleCount();
+            this->client.setTimeout(METRICS_PUSH_CONNECT_MS);
+            if (!this->client.connect(METRICS_PUSH_HOST, METRICS_PUSH_PORT)) {
+              LOG_WARN("Metrics push: cannot connect to %s:%u, %u batches queued", METRICS_PUSH_HOST, METRICS_PUSH_PORT, this->count);
+              this->failures++;
+              return;
+            }
+            this->client.setNoDelay(true);
+            this->client.print(F("POST " METRICS_PUSH_PATH " HTTP/1.1\r\nHost: " METRICS_PUSH_HOST "\r\n"
+              "Content-Type: " PROM_CONTENT_TYPE "\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n"));
+
+            const PromBatch &batch = this->queue[this->head];
+            ChunkedClientPrint body(this->client);
+            MiniPromClient client(body, batch, METRICS_PUSH_TIMESTAMPS);
+            this->writer(client);
+            client.end();
+            body.end();
+            if (!client.complete())
+              LOG_WARN("Metrics batch %u does not match the current metrics", (unsigned) batch.seq);
+
+            this->sentSeq = batch.seq;
+            this->sentAt = millis();
+            this->statusLength = 0;
+            this->state = PUSH_WAITING;
+        };
+
+        void poll(){
+            while (this->statusLength < sizeof(this->status) - 1 && this->client.available() > 0)
+              this->status[this->statusLength++] = this->client.read();
+            if (this->statusLength < sizeof(this->status) - 1) {
+              if (!this->client.connected() || millis() - this->sentAt > METRICS_PUSH_RESPONSE_MS)
+                finish(0);
+              return;
+            }
+            this->status[this->statusLength] = '\0';
+            // "HTTP/1.1 204"
+            finish(strncmp(this->status, "HTTP/1.", 7) == 0 ? atoi(this->status + 9) : 0);
+        };
+
+        void finish(int code){
+            this->client.stop();
+            this->state = PUSH_IDLE;
+            bool sent = this->count > 0 && this->queue[this->head].seq == this->sentSeq;
+
+            if (code >= 200 && code < 300) {
+              this->lastLatency = (ESP.getCycleCount() - this->startCycles) / ESP.getCpuFreqMHz();
+              this->latency.record(this->lastLatency);
+              this->pushed++;
+              if (sent)
+                pop();
+              this->draining = this->count > 0;
+              return;
+            }
+
+            this->failures++;
+            if (code >= 400 && code < 500 && code != 429 && sent) {
+              LOG_ERROR("Metrics push refused with %d, batch dropped", code);
+              this->droppedSamples += this->queue[this->head].samples;
+              pop();
+            } else {
+              LOG_WARN("Metrics push failed (%d), %u batches queued", code, this->count);
+            }
+        };
+};
+
+#endif
@@ -0,0 +1,1020 @@
+#ifndef MULTI_WEB_SERVER_H
+#define MULTI_WEB_SERVER_H
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h> // HTTPMethod, HTTPUpload, mime::getContentType
+#include <WiFiClient.h>
+#include <WiFiServer.h>
+#include <FS.h>
+#include <functional>
+#include <memory>
+#include "Log.h"
+
+#define MULTI_WEB_CLIENTS 4
+#define MULTI_WEB_ROUTES 32
+#define MULTI_WEB_HEADERS 4 // Collected request headers
+#define MULTI_WEB_ARGS 8
+#define MULTI_WEB_LINE_MAX 256 // Request line, header line or form field value
+#define MULTI_WEB_SEND_BUFFER 1024 // Per connection
+#define MULTI_WEB_BODY_MAX 4096 // Bodies other than uploads, read into arg("plain")
+#define MULTI_WEB_READ_BUDGET 512 // Bytes parsed per connection and handleClient()
+#define MULTI_WEB_IDLE_MS 5000 // Longest silence in the middle of a request or response
+#define MULTI_WEB_KEEPALIVE_MS 2000 // Wait for the next request on a persistent connection
+#define MULTI_WEB_MAX_REQUESTS 16 // Per connection, the last response closes it
+#define MULTI_WEB_BLOCK_MS 2000 // Longest wait of a handler writing more than the send buffer holds
+#define MULTI_WEB_CLOSE_WAIT_MS 1 // Wait for the ACKs of a response before closing, stop() alone waits up to WIFICLIENT_MAX_FLUSH_WAIT_MS
+
+typedef enum {
+  WEB_CONN_FREE,
+  WEB_CONN_REQUEST, // Request line
+  WEB_CONN_HEADERS,
+  WEB_CONN_BODY,
+  WEB_CONN_UPLOAD, // multipart/form-data body
+  WEB_CONN_SEND // Send buffer, then the streamed file if any
+} WebConnState;
+
+typedef enum {
+  WEB_PART_DATA, // Scanning for the delimiter, before the first part the bytes are dropped
+  WEB_PART_AFTER, // "\r\n" (next part) or "--" (end) after a delimiter
+  WEB_PART_HEADERS,
+  WEB_PART_DONE
+} WebPartState;
+
+typedef struct {
+  unsigned long accepted;
+  unsigned long requests;
+  unsigned long rejected; // 4xx/5xx sent by the server itself: full, too large, malformed
+  unsigned long timeouts;
+  unsigned long reused; // Requests served on a connection that had already answered one
+  unsigned long pipelined; // Requests already received when the previous response completed
+  unsigned long idleClosed; // Persistent connections closed after MULTI_WEB_KEEPALIVE_MS
+  unsigned long evicted; // Idle persistent connections closed to accept a new client
+  unsigned long blockedWrites; // Handler output waited for the client to make room
+  uint8_t active;
+  uint8_t maxActive;
+} MultiWebStats;
+
+// One client of MultiWebServer: the request being parsed, then the response
+// being sent. Only the send buffer is written by handlers, file bodies are
+// read into it as the client acknowledges. Bytes read past the end of a
+// request stay in input for the next one (pipelining).
+typedef struct {
+  WiFiClient client;
+  uint8_t state;
+  unsigned long lastActivity; // ms
+  bool http10;
+  bool keepAlive; // From the request, cleared when the response cannot be delimited
+  uint8_t served; // Responses completed on this connection
+
+  uint8_t input[64];
+  uint8_t inputStart;
+  uint8_t inputEnd;
+
+  char line[MULTI_WEB_LINE_MAX];
+  uint16_t lineLength;
+  bool lineOverflow;
+
+  HTTPMethod method;
+  String uri;
+  String argNames[MULTI_WEB_ARGS];
+  String argValues[MULTI_WEB_ARGS];
+  uint8_t argCount;
+  String headers[MULTI_WEB_HEADERS]; // Indexed like MultiWebServer::headerKeys
+  bool hasHeader[MULTI_WEB_HEADERS];
+
+  size_t contentLength;
+  size_t bodyRead;
+  bool formEncoded;
+  String body;
+
+  // multipart/form-data
+  String delimiter; // "\r\n--" boundary
+  uint8_t partState;
+  uint16_t match; // Delimiter bytes matched so far
+  bool partIsFile;
+  String partName;
+  String partValue;
+
+  uint8_t sendBuffer[MULTI_WEB_SEND_BUFFER];
+  uint16_t sendStart;
+  uint16_t sendEnd;
+  File file;
+  size_t fileRemaining;
+  bool replied; // An upload handler already answered, the request handler is skipped
+  bool taken; // The handler kept client() without replying, the socket is its own now
+} WebConnection;
+
+// Drop-in for the part of ESP8266WebServer used by Webserver, serving up to
+// MULTI_WEB_CLIENTS connections at once. handleClient() only does what needs
+// no waiting: read what has arrived, write what the TCP window takes. Each
+// connection is a small state machine, so a slow client costs memory instead
+// of loop() time. Handlers still run synchronously; output larger than the
+// send buffer waits for the client, up to MULTI_WEB_BLOCK_MS, except file
+// bodies which are streamed from handleClient().
+// HTTP/1.1 connections are persistent unless the client asks otherwise or the
+// response has neither a length nor chunks. Pipelined requests are answered in
+// order, the next one is parsed once the previous response is out. Idle
+// persistent connections give their slot to new clients.
+class MultiWebServer {
+    public:
+        typedef std::function<void(void)> THandlerFunction;
+
+        MultiWebServer(int port = 80) : server(port) {};
+        virtual ~MultiWebServer() {};
+
+        void begin(){
+            this->server.begin();
+            this->server.setNoDelay(true);
+        };
+
+        void close(){
+            this->server.close();
+            for (uint8_t i = 0; i < MULTI_WEB_CLIENTS; i++) {
+              if (this->connections[i].state != WEB_CONN_FREE)
+                drop(this->connections[i]);
+            }
+        };
+
+        void stop(){ close(); };
+
+        void on(const String &uri, HTTPMethod method, THandlerFunction fn){
+            on(uri, method, fn, nullptr);
+        };
+
+        void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction uploadFn){
+            if (this->routeCount == MULTI_WEB_ROUTES) {
+              LOG_ERROR("Too many routes, %s is not served", uri);
+              return;
+            }
+            this->routes[this->routeCount++] = {uri, method, fn, uploadFn};
+        };
+
+        void onNotFound(THandlerFunction fn){ this->notFoundHandler = fn; };
+
+        void collectHeaders(const char * headerKeys[], const size_t headerKeysCount){
+            this->headerKeyCount = headerKeysCount < MULTI_WEB_HEADERS ? headerKeysCount : MULTI_WEB_HEADERS;
+            for (uint8_t i = 0; i < this->headerKeyCount; i++)
+              this->headerKeys[i] = headerKeys[i];
+        };
+
+        void handleClient(){
+            while (this->server.hasClient()) {
+              WebConnection * connection = freeConnection();
+              if (!connection)
+                connection = evictIdle();
+              if (!connection)
+                break; // Waits in the listen backlog until a slot frees up
+              accept(*connection, this->server.accept());
+            }
+
+            for (uint8_t i = 0; i < MULTI_WEB_CLIENTS; i++) {
+              WebConnection &connection = this->connections[i];
+              if (connection.state != WEB_CONN_FREE)
+                service(connection);
+            }
+        };
+
+        // Request accessors, valid while a handler runs
+        const String & uri() const { return this->current->uri; };
+        HTTPMethod method() const { return this->current->method; };
+        int args() const { return this->current->argCount; };
+        String arg(int i) const { return i < this->current->argCount ? this->current->argValues[i] : String(); };
+        String argName(int i) const { return i < this->current->argCount ? this->current->argNames[i] : String(); };
+
+        String arg(const String &name) const {
+            for (uint8_t i = 0; i < this->current->argCount; i++) {
+              if (this->current->argNames[i] == name)
+                return this->current->argValues[i];
+            }
+            return String();
+        };
+
+        bool hasArg(const String &name) const {
+            for (uint8_t i = 0; i < this->current->argCount; i++) {
+              if (this->current->argNames[i] == name)
+                return true;
+            }
+            return false;
+        };
+
+        String header(const String &name) const {
+            int8_t index = headerIndex(name.c_str());
+            return index >= 0 && this->current->hasHeader[index] ? this->current->headers[index] : String();
+        };
+
+        bool hasHeader(const String &name) const {
+            int8_t index = headerIndex(name.c_str());
+            return index >= 0 && this->current->hasHeader[index];
+        };
+
+        HTTPUpload & upload(){ return *this->uploadState; };
+
+        // Direct access bypasses the send buffer, what is buffered goes out first.
+        // A handler that keeps a copy and sends nothing through the server owns the
+        // connection afterwards, as with ESP8266WebServer
+        WiFiClient & client(){
+            drain(*this->current);
+            this->current->taken = true;
+            return this->current->client;
+        };
+
+        void sendHeader(const String &name, const String &value, bool first = false){
+            String line = name;
+            line += F(": ");
+            line += value;
+            line += F("\r\n");
+            if (first)
+              this->responseHeaders = line + this->responseHeaders;
+            else
+              this->responseHeaders += line;
+        };
+
+        void setContentLength(const size_t contentLength){ this->contentLength = contentLength; };
+
+        void send(int code, const char * contentType = nullptr, const String &content = String()){
+            size_t length = this->contentLength == CONTENT_LENGTH_NOT_SET ? content.length() : this->contentLength;
+            writeHead(code, contentType, length);
+            sendBody(content.c_str(), content.length());
+        };
+
+        void send(int code, const String &contentType, const String &content){
+            send(code, contentType.c_str(), content);
+        };
+
+        void send(int code, const char * contentType, const char * content, size_t length){
+            setContentLength(length);
+            writeHead(code, contentType, length);
+            sendBody(content, length);
+        };
+
+        void send_P(int code, PGM_P contentType, PGM_P content){
+            String type(FPSTR(contentType));
+            send(code, type, String(FPSTR(content)));
+        };
+
+        void sendContent(const String &content){ sendContent(content.c_str(), content.length()); };
+
+        void sendContent(const char * content, size_t size){
+            if (this->chunked) {
+              if (size == 0)
+                return; // An empty chunk would end the body
+              char prefix[12];
+              int n = snprintf(prefix, sizeof(prefix), "%x\r\n", (unsigned) size);
+              sendBody(prefix, n);
+              sendBody(content, size);
+              sendBody("\r\n", 2);
+            } else {
+              sendBody(content, size);
+            }
+        };
+
+        void sendContent_P(PGM_P content){ sendContent(String(FPSTR(content))); };
+        void sendContent_P(PGM_P content, size_t size){ sendContent(String(FPSTR(content)).c_str(), size); };
+
+        // HTTP/1.0 clients cannot take chunks, the caller then sends a close-delimited body
+        bool chunkedResponseModeStart(int code, const char * contentType){
+            if (this->current->http10)
+              return false;
+            this->chunked = true;
+            writeHead(code, contentType, CONTENT_LENGTH_UNKNOWN);
+            return true;
+        };
+
+        bool chunkedResponseModeStart(int code, const String &contentType){
+            return chunkedResponseModeStart(code, contentType.c_str());
+        };
+
+        bool chunkedResponseModeStart_P(int code, PGM_P contentType){
+            return chunkedResponseModeStart(code, String(FPSTR(contentType)).c_str());
+        };
+
+        void chunkedResponseFinalize(){
+            if (!this->chunked)
+              return;
+            sendBody("0\r\n\r\n", 5);
+            this->chunked = false;
+        };
+
+        // The file is read from handleClient() as the client takes it, the caller
+        // may drop its handle but must not close() it
+        size_t streamFile(File &file, const String &contentType, HTTPMethod requestMethod = HTTP_GET){
+            String name(file.name());
+            if (name.endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream")
+              sendHeader(F("Content-Encoding"), F("gzip"));
+            size_t size = file.size();
+            setContentLength(size);
+            send(200, contentType.c_str(), String());
+            if (requestMethod != HTTP_HEAD && this->current->method != HTTP_HEAD) {
+              this->current->file = file;
+              this->current->fileRemaining = size;
+            }
+            return size;
+        };
+
+        static String urlDecode(const String &text){
+            String decoded;
+            decoded.reserve(text.length());
+            for (unsigned int i = 0; i < text.length(); i++) {
+              char c = text[i];
+              if (c == '%' && i + 2 < text.length()) {
+                char hex[3] = {text[i + 1], text[i + 2], '\0'};
+                decoded += (char) strtol(hex, nullptr, 16);
+                i += 2;
+              } else if (c == '+') {
+                decoded += ' ';
+              } else {
+                decoded += c;
+              }
+            }
+            return decoded;
+        };
+
+        const MultiWebStats & getStats(){ return this->stats; };
+
+    private:
+        struct Route {
+          String uri;
+          HTTPMethod method;
+          THandlerFunction fn;
+          THandlerFunction uploadFn;
+        };
+
+        WiFiServer server;
+        Route routes[MULTI_WEB_ROUTES];
+        uint8_t routeCount = 0;
+        THandlerFunction notFoundHandler;
+        const char * headerKeys[MULTI_WEB_HEADERS];
+        uint8_t headerKeyCount = 0;
+        WebConnection connections[MULTI_WEB_CLIENTS];
+        WebConnection * current = &connections[0]; // Connection whose handler runs
+        std::unique_ptr<HTTPUpload> uploadState; // One upload at a time, it holds HTTP_UPLOAD_BUFLEN
+        WebConnection * uploadOwner = nullptr;
+        MultiWebStats stats = {};
+
+        // Response being written by the handler
+        String responseHeaders;
+        size_t contentLength = CONTENT_LENGTH_NOT_SET;
+        bool chunked = false;
+        bool responded = false;
+
+        WebConnection * freeConnection(){
+            for (uint8_t i = 0; i < MULTI_WEB_CLIENTS; i++) {
+              if (this->connections[i].state == WEB_CONN_FREE)
+                return &this->connections[i];
+            }
+            return nullptr;
+        };
+
+        // Between two requests, nothing of the next one received yet
+        static bool idle(const WebConnection &c){
+            return c.state == WEB_CONN_REQUEST && c.served > 0 && c.lineLength == 0 && c.inputStart == c.inputEnd;
+        };
+
+        // Frees the connection idle for the longest time, if any
+        WebConnection * evictIdle(){
+            WebConnection * oldest = nullptr;
+            for (uint8_t i = 0; i < MULTI_WEB_CLIENTS; i++) {
+              WebConnection &c = this->connections[i];
+              if (idle(c) && (!oldest || (long) (c.lastActivity - oldest->lastActivity) < 0))
+                oldest = &c;
+            }
+            if (oldest) {
+              this->stats.evicted++;
+              drop(*oldest);
+            }
+            return oldest;
+        };
+
+        void accept(WebConnection &c, WiFiClient client){
+            c.client = client;
+            c.client.setNoDelay(true);
+            c.lastActivity = millis();
+            c.served = 0;
+            c.inputStart = 0;
+            c.inputEnd = 0;
+            resetRequest(c);
+
+            this->stats.accepted++;
+            this->stats.active++;
+            if (this->stats.active > this->stats.maxActive)
+              this->stats.maxActive = this->stats.active;
+        };
+
+        void resetRequest(WebConnection &c){
+            c.state = WEB_CONN_REQUEST;
+            c.http10 = false;
+            c.keepAlive = false;
+            c.lineLength = 0;
+            c.lineOverflow = false;
+            c.method = HTTP_GET;
+            c.uri = String();
+            c.argCount = 0;
+            for (uint8_t i = 0; i < MULTI_WEB_HEADERS; i++)
+              c.hasHeader[i] = false;
+            c.contentLength = 0;
+            c.bodyRead = 0;
+            c.formEncoded = false;
+            c.body = String();
+            c.delimiter = String();
+            c.sendStart = 0;
+            c.sendEnd = 0;
+            c.fileRemaining = 0;
+            c.file = File();
+            c.replied = false;
+            c.taken = false;
+        };
+
+        // Response complete: the next request, or the end of the connection
+        void finish(WebConnection &c){
+            if (!c.keepAlive)
+              return drop(c);
+            c.served++;
+            resetRequest(c);
+            c.lastActivity = millis();
+            if (c.inputStart != c.inputEnd || c.client.available() > 0)
+              this->stats.pipelined++;
+        };
+
+        // Closing does not wait for the client, the stack still sends what is queued.
+        // A reset throws it away instead, for clients that stopped reading
+        void drop(WebConnection &c, bool reset = false){
+            if (this->uploadOwner == &c) {
+              if (c.partIsFile && c.partState == WEB_PART_DATA)
+                callUpload(c, UPLOAD_FILE_ABORTED);
+              releaseUpload();
+            }
+            if (reset)
+              c.client.abort();
+            else
+              c.client.stop(MULTI_WEB_CLOSE_WAIT_MS);
+            c.client = WiFiClient();
+            c.file = File();
+            c.body = String();
+            c.state = WEB_CONN_FREE;
+            this->stats.active--;
+        };
+
+        // Still parsing a request, not answering it nor handed over
+        static bool reading(const WebConnection &c){
+            return c.state != WEB_CONN_FREE && c.state != WEB_CONN_SEND;
+        };
+
+        void service(WebConnection &c){
+            // A response completing here lets the next pipelined request be parsed in the same pass
+            if (c.state == WEB_CONN_SEND)
+              pump(c);
+
+            if (reading(c)) {
+              size_t budget = MULTI_WEB_READ_BUDGET;
+              while (budget > 0 && reading(c)) {
+                if (c.inputStart == c.inputEnd) {
+                  if (c.client.available() <= 0)
+                    break;
+                  int n = c.client.read(c.input, budget < sizeof(c.input) ? budget : sizeof(c.input));
+                  if (n <= 0)
+                    break;
+                  budget -= n;
+                  c.inputStart = 0;
+                  c.inputEnd = n;
+                  c.lastActivity = millis();
+                }
+                feed(c, c.input[c.inputStart++]);
+              }
+              if (c.state == WEB_CONN_SEND)
+                pump(c);
+            }
+
+            if (c.state == WEB_CONN_FREE)
+              return;
+            if (!c.client.connected()) {
+              drop(c);
+            } else if (idle(c)) {
+              if (millis() - c.lastActivity > MULTI_WEB_KEEPALIVE_MS) {
+                this->stats.idleClosed++;
+                drop(c);
+              }
+            } else if (millis() - c.lastActivity > MULTI_WEB_IDLE_MS) {
+              this->stats.timeouts++;
+              drop(c, true);
+            }
+        };
+
+        // Moves the response out: buffered bytes as the window allows, then the file
+        void pump(WebConnection &c){
+            flush(c);
+            if (c.fileRemaining > 0) {
+              compact(c);
+              size_t room = MULTI_WEB_SEND_BUFFER - c.sendEnd;
+              if (room > 0) {
+                int n = c.file.read(c.sendBuffer + c.sendEnd, room < c.fileRemaining ? room : c.fileRemaining);
+                if (n <= 0) {
+                  LOG_WARN("Read failed with %u bytes left", (unsigned) c.fileRemaining);
+                  drop(c, true);
+                  return;
+                }
+                c.sendEnd += n;
+                c.fileRemaining -= n;
+                flush(c);
+              }
+            }
+            if (c.sendStart == c.sendEnd && c.fileRemaining == 0)
+              finish(c);
+        };
+
+        // Non-blocking write of the buffered bytes
+        void flush(WebConnection &c){
+            size_t pending = c.sendEnd - c.sendStart;
+            if (pending == 0)
+              return;
+            int window = c.client.availableForWrite();
+            if (window <= 0)
+              return;
+            size_t n = c.client.write(c.sendBuffer + c.sendStart, pending < (size_t) window ? pending : (size_t) window);
+            if (n > 0)
+              c.lastActivity = millis();
+            c.sendStart += n;
+            if (c.sendStart == c.sendEnd)
+              c.sendStart = c.sendEnd = 0;
+        };
+
+        void compact(WebConnection &c){
+            if (c.sendStart == 0)
+              return;
+            memmove(c.sendBuffer, c.sendBuffer + c.sendStart, c.sendEnd - c.sendStart);
+            c.sendEnd -= c.sendStart;
+            c.sendStart = 0;
+        };
+
+        // Blocking flush for handlers overflowing the buffer and for client()
+        bool drain(WebConnection &c){
+            unsigned long start = millis();
+            flush(c);
+            while (c.sendStart != c.sendEnd) {
+              if (!c.client.connected() || millis() - start > MULTI_WEB_BLOCK_MS)
+                return false;
+              delay(1);
+              flush(c);
+            }
+            return true;
+        };
+
+        void output(WebConnection &c, const char * data, size_t size){
+            while (size > 0) {
+              compact(c);
+              if (c.sendEnd == MULTI_WEB_SEND_BUFFER) {
+                this->stats.blockedWrites++;
+                flush(c);
+                if (c.sendEnd - c.sendStart == MULTI_WEB_SEND_BUFFER && !drain(c)) {
+                  LOG_WARN("Client too slow, %u bytes dropped", (unsigned) size);
+                  c.client.abort(); // Freed by the next service()
+                  return;
+                }
+                continue;
+              }
+              size_t n = MULTI_WEB_SEND_BUFFER - c.sendEnd;
+              if (n > size)
+                n = size;
+              memcpy(c.sendBuffer + c.sendEnd, data, n);
+              c.sendEnd += n;
+              data += n;
+              size -= n;
+            }
+        };
+
+        void sendBody(const char * data, size_t size){
+            if (size > 0 && this->current->method != HTTP_HEAD)
+              output(*this->current, data, size);
+        };
+
+        void writeHead(int code, const char * contentType, size_t length){
+            WebConnection &c = *this->current;
+            String head = c.http10 ? F("HTTP/1.0 ") : F("HTTP/1.1 ");
+            head += code;
+            head += ' ';
+            head += statusText(code);
+            head += F("\r\nContent-Type: ");
+            head += contentType ? contentType : "text/html";
+            if (this->chunked) {
+              head += F("\r\nTransfer-Encoding: chunked");
+            } else if (length != CONTENT_LENGTH_UNKNOWN) {
+              head += F("\r\nContent-Length: ");
+              head += (unsigned long) length;
+            }
+            head += F("\r\n");
+            head += this->responseHeaders;
+            // Without a length the body ends with the connection
+            if (!this->chunked && length == CONTENT_LENGTH_UNKNOWN)
+              c.keepAlive = false;
+            if (c.served + 1 >= MULTI_WEB_MAX_REQUESTS)
+              c.keepAlive = false;
+            if (c.keepAlive) {
+              char keepAlive[64];
+              snprintf(keepAlive, sizeof(keepAlive), "Connection: keep-alive\r\nKeep-Alive: timeout=%u, max=%u\r\n\r\n",
+                MULTI_WEB_KEEPALIVE_MS / 1000, MULTI_WEB_MAX_REQUESTS - c.served - 1);
+              head += keepAlive;
+            } else {
+              head += F("Connection: close\r\n\r\n");
+            }
+            output(c, head.c_str(), head.length());
+
+            this->responseHeaders = String();
+            this->contentLength = CONTENT_LENGTH_NOT_SET;
+            this->responded = true;
+        };
+
+        static const char * statusText(int code){
+            switch (code) {
+              case 200: return "OK";
+              case 204: return "No Content";
+              case 301: return "Moved Permanently";
+              case 302: return "Found";
+              case 304: return "Not Modified";
+              case 400: return "Bad Request";
+              case 401: return "Unauthorized";
+              case 403: return "Forbidden";
+              case 404: return "Not Found";
+              case 405: return "Method Not Allowed";
+              case 413: return "Payload Too Large";
+              case 414: return "URI Too Long";
+              case 500: return "Internal Server Error";
+              case 503: return "Service Unavailable";
+              default: return "";
+            }
+        };
+
+        // Error sent by the server itself, the connection closes once it is out:
+        // what is left of the request is not read
+        void reject(WebConnection &c, int code){
+            this->current = &c;
+            c.keepAlive = false;
+            this->responseHeaders = String();
+            this->contentLength = CONTENT_LENGTH_NOT_SET;
+            this->chunked = false;
+            send(code, "text/plain", String(statusText(code)));
+            c.state = WEB_CONN_SEND;
+            this->stats.rejected++;
+        };
+
+        int8_t headerIndex(const char * name) const {
+            for (uint8_t i = 0; i < this->headerKeyCount; i++) {
+              if (strcasecmp(this->headerKeys[i], name) == 0)
+                return i;
+            }
+            return -1;
+        };
+
+        static HTTPMethod methodFromName(const char * name){
+            static const char * const names[] = {"GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS"};
+            static const HTTPMethod methods[] = {HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS};
+            for (uint8_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+              if (strcmp(names[i], name) == 0)
+                return methods[i];
+            }
+            return HTTP_ANY;
+        };
+
+        static void addArg(WebConnection &c, const String &name, const String &value){
+            if (c.argCount == MULTI_WEB_ARGS)
+              return;
+            c.argNames[c.argCount] = name;
+            c.argValues[c.argCount] = value;
+            c.argCount++;
+        };
+
+        // name=value&name=value, URL encoded
+        static void parseArgs(WebConnection &c, const char * query, size_t length){
+            size_t start = 0;
+            while (start < length) {
+              size_t end = start;
+              while (end < length && query[end] != '&')
+                end++;
+              size_t equals = start;
+              while (equals < end && query[equals] != '=')
+                equals++;
+              if (end > start) {
+                String name(query + start, equals - start);
+                String value = equals < end ? String(query + equals + 1, end - equals - 1) : String();
+                addArg(c, urlDecode(name), urlDecode(value));
+              }
+              start = end + 1;
+            }
+        };
+
+        // Collects one CRLF terminated line, true once it is complete
+        static bool collectLine(WebConnection &c, uint8_t byte){
+            if (byte == '\n') {
+              if (c.lineLength > 0 && c.line[c.lineLength - 1] == '\r')
+                c.lineLength--;
+              c.line[c.lineLength] = '\0';
+              return true;
+            }
+            if (c.lineLength < MULTI_WEB_LINE_MAX - 1)
+              c.line[c.lineLength++] = byte;
+            else
+              c.lineOverflow = true;
+            return false;
+        };
+
+        void feed(WebConnection &c, uint8_t byte){
+            switch (c.state) {
+              case WEB_CONN_REQUEST:
+                if (collectLine(c, byte)) {
+                  if (c.lineLength == 0 && !c.lineOverflow)
+                    return; // Stray CRLF between requests is allowed
+                  if (c.lineOverflow)
+                    return reject(c, 414);
+                  if (!parseRequestLine(c))
+                    return reject(c, 400);
+                  c.lineLength = 0;
+                  c.state = WEB_CONN_HEADERS;
+                }
+                break;
+              case WEB_CONN_HEADERS:
+                if (collectLine(c, byte)) {
+                  if (c.lineLength == 0 && !c.lineOverflow)
+                    return beginBody(c);
+                  if (!c.lineOverflow)
+                    parseHeader(c);
+                  c.lineLength = 0;
+                  c.lineOverflow = false; // Long headers (cookies) are skipped
+                }
+                break;
+              case WEB_CONN_BODY:
+                c.body += (char) byte;
+                if (++c.bodyRead == c.contentLength)
+                  endBody(c);
+                break;
+              case WEB_CONN_UPLOAD:
+                feedPart(c, byte);
+                if (c.state == WEB_CONN_UPLOAD && ++c.bodyRead == c.contentLength) {
+                  if (c.partState != WEB_PART_DONE) {
+                    if (c.partIsFile && c.partState == WEB_PART_DATA)
+                      callUpload(c, UPLOAD_FILE_ABORTED);
+                    releaseUpload();
+                    return reject(c, 400);
+                  }
+                  releaseUpload();
+                  dispatch(c);
+                }
+                break;
+            }
+        };
+
+        bool parseRequestLine(WebConnection &c){
+            char * uri = strchr(c.line, ' ');
+            if (!uri)
+              return false;
+            *uri++ = '\0';
+            char * version = strchr(uri, ' ');
+            if (!version)
+              return false;
+            *version++ = '\0';
+
+            c.method = methodFromName(c.line);
+            c.http10 = strcmp(version, "HTTP/1.0") == 0;
+            c.keepAlive = !c.http10; // Until a Connection header says otherwise
+            char * query = strchr(uri, '?');
+            if (query) {
+              *query++ = '\0';
+              parseArgs(c, query, strlen(query));
+            }
+            c.uri = uri;
+            return c.method != HTTP_ANY;
+        };
+
+        void parseHeader(WebConnection &c){
+            char * value = strchr(c.line, ':');
+            if (!value)
+              return;
+            *value++ = '\0';
+            while (*value == ' ')
+              value++;
+
+            if (strcasecmp(c.line, "Content-Length") == 0) {
+              c.contentLength = strtoul(value, nullptr, 10);
+            } else if (strcasecmp(c.line, "Connection") == 0) {
+              if (strcasestr(value, "close"))
+                c.keepAlive = false;
+              else if (strcasestr(value, "keep-alive"))
+                c.keepAlive = true;
+            } else if (strcasecmp(c.line, "Content-Type") == 0) {
+              if (strncasecmp(value, "multipart/form-data", 19) == 0) {
+                const char * boundary = strstr(value, "boundary=");
+                if (boundary) {
+                  c.delimiter = F("\r\n--");
+                  c.delimiter += boundary + 9;
+                }
+              } else {
+                c.formEncoded = strncasecmp(value, "application/x-www-form-urlencoded", 33) == 0;
+              }
+            }
+
+            int8_t index = headerIndex(c.line);
+            if (index >= 0) {
+              c.headers[index] = value;
+              c.hasHeader[index] = true;
+            }
+        };
+
+        void beginBody(WebConnection &c){
+            if (c.contentLength == 0)
+              return dispatch(c);
+
+            if (c.delimiter.length() > 0) {
+              if (this->uploadOwner)
+                return reject(c, 503);
+              this->uploadState.reset(new HTTPUpload());
+              this->uploadOwner = &c;
+              c.partState = WEB_PART_DATA;
+              c.match = 2; // The first delimiter has no leading CRLF
+              c.partIsFile = false;
+              c.partName = String();
+              c.partValue = String();
+              c.lineLength = 0;
+              c.state = WEB_CONN_UPLOAD;
+              return;
+            }
+
+            if (c.contentLength > MULTI_WEB_BODY_MAX)
+              return reject(c, 413);
+            c.body.reserve(c.contentLength);
+            c.state = WEB_CONN_BODY;
+        };
+
+        void endBody(WebConnection &c){
+            if (c.formEncoded)
+              parseArgs(c, c.body.c_str(), c.body.length());
+            addArg(c, F("plain"), c.body);
+            c.body = String();
+            dispatch(c);
+        };
+
+        void releaseUpload(){
+            this->uploadState.reset();
+            this->uploadOwner = nullptr;
+        };
+
+        void callUpload(WebConnection &c, HTTPUploadStatus status){
+            this->uploadState->status = status;
+            Route * route = findRoute(c);
+            if (route && route->uploadFn) {
+              this->current = &c;
+              this->responded = false;
+              route->uploadFn();
+              if (this->responded)
+                c.replied = true;
+            }
+            this->uploadState->currentSize = 0;
+        };
+
+        void partByte(WebConnection &c, uint8_t byte){
+            if (c.partIsFile) {
+              HTTPUpload &upload = *this->uploadState;
+              upload.buf[upload.currentSize++] = byte;
+              upload.totalSize++;
+              if (upload.currentSize == HTTP_UPLOAD_BUFLEN)
+                callUpload(c, UPLOAD_FILE_WRITE);
+            } else if (c.partState == WEB_PART_DATA && c.partName.length() > 0 && c.partValue.length() < MULTI_WEB_LINE_MAX) {
+              c.partValue += (char) byte;
+            }
+        };
+
+        void endPart(WebConnection &c){
+            if (c.partIsFile) {
+              if (this->uploadState->currentSize > 0)
+                callUpload(c, UPLOAD_FILE_WRITE);
+              callUpload(c, UPLOAD_FILE_END);
+            } else if (c.partName.length() > 0) {
+              addArg(c, c.partName, c.partValue);
+            }
+            c.partIsFile = false;
+            c.partName = String();
+            c.partValue = String();
+        };
+
+        void feedPart(WebConnection &c, uint8_t byte){
+            switch (c.partState) {
+              case WEB_PART_DATA:
+                if (byte == (uint8_t) c.delimiter[c.match]) {
+                  if (++c.match == c.delimiter.length()) {
+                    endPart(c);
+                    c.match = 0;
+                    c.partState = WEB_PART_AFTER;
+                  }
+                  return;
+                }
+                // '\r' only starts the delimiter, a failed match restarts on it
+                for (uint16_t i = 0; i < c.match; i++)
+                  partByte(c, c.delimiter[i]);
+                c.match = byte == '\r' ? 1 : 0;
+                if (c.match == 0)
+                  partByte(c, byte);
+                break;
+              case WEB_PART_AFTER:
+                c.line[c.match++] = byte;
+                if (c.match == 2) {
+                  c.match = 0;
+                  c.lineLength = 0;
+                  c.partState = c.line[0] == '-' && c.line[1] == '-' ? WEB_PART_DONE : WEB_PART_HEADERS;
+                  this->uploadState->filename = String();
+                  this->uploadState->type = String();
+                }
+                break;
+              case WEB_PART_HEADERS:
+                if (collectLine(c, byte)) {
+                  if (c.lineLength == 0 && !c.lineOverflow)
+                    return beginPart(c);
+                  if (!c.lineOverflow)
+                    parsePartHeader(c);
+                  c.lineLength = 0;
+                  c.lineOverflow = false;
+                }
+                break;
+              case WEB_PART_DONE:
+                break; // Epilogue
+            }
+        };
+
+        void parsePartHeader(WebConnection &c){
+            if (strncasecmp(c.line, "Content-Disposition:", 20) == 0) {
+              c.partName = quotedParameter(c.line, " name=");
+              if (strstr(c.line, "filename=")) {
+                c.partIsFile = true;
+                this->uploadState->filename = quotedParameter(c.line, "filename=");
+              }
+            } else if (strncasecmp(c.line, "Content-Type:", 13) == 0) {
+              const char * type = c.line + 13;
+              while (*type == ' ')
+                type++;
+              this->uploadState->type = type;
+            }
+        };
+
+        static String quotedParameter(const char * line, const char * key){
+            const char * start = strstr(line, key);
+            if (!start)
+              return String();
+            start += strlen(key);
+            if (*start == '"')
+              start++;
+            const char * end = start;
+            while (*end && *end != '"' && *end != ';')
+              end++;
+            return String(start, end - start);
+        };
+
+        void beginPart(WebConnection &c){
+            c.partState = WEB_PART_DATA;
+            c.match = 0;
+            if (!c.partIsFile)
+              return;
+            HTTPUpload &upload = *this->uploadState;
+            upload.name = c.partName;
+            upload.totalSize = 0;
+            upload.currentSize = 0;
+            if (upload.type.length() == 0)
+              upload.type = mime::getContentType(upload.filename);
+            callUpload(c, UPLOAD_FILE_START);
+        };
+
+        Route * findRoute(WebConnection &c){
+            for (uint8_t i = 0; i < this->routeCount; i++) {
+              Route &route = this->routes[i];
+              if ((route.method == HTTP_ANY || route.method == c.method) && route.uri == c.uri)
+                return &route;
+            }
+            return nullptr;
+        };
+
+        void dispatch(WebConnection &c){
+            this->current = &c;
+            this->responseHeaders = String();
+            this->contentLength = CONTENT_LENGTH_NOT_SET;
+            this->chunked = false;
+            this->responded = false;
+            this->stats.requests++;
+            if (c.served > 0)
+              this->stats.reused++;
+
+            Route * route = findRoute(c);
+            if (c.replied)
+              this->responded = true;
+            else if (route)
+              route->fn();
+            else if (this->notFoundHandler)
+              this->notFoundHandler();
+            if (!this->responded && c.taken) {
+              // Handed over, released without closing
+              c.client = WiFiClient();
+              c.state = WEB_CONN_FREE;
+              this->stats.active--;
+              return;
+            }
+            if (!this->responded)
+              send(route || this->notFoundHandler ? 500 : 404, "text/plain", String());
+            this->chunked = false;
+            c.state = WEB_CONN_SEND;
+        };
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "timer.h"
+#include "FixedTimeTimer.h"
+#include "Log.h"
+#include "LatencyHistogram.h"
+#include <functional>
+#include <time.h>
+
+#define SCHEDULER_MAX_JOBS 8
+#define SCHEDULER_NO_JOB 0xFF
+
+typedef uint8_t JobId;
+
+typedef struct {
+  const char * name;
+  unsigned int type;          // SINGLE_SHOT, LOOP_UNTIL_STOP or WALL_CLOCK
+  unsigned long interval;     // Seconds, SINGLE_SHOT / LOOP_UNTIL_STOP
+  unsigned int startAt;       // Second of the day, WALL_CLOCK
+  unsigned long deadline;     // Epoch second at which the job is due
+  unsigned long fireCount;
+  unsigned long lastLateness; // Seconds between deadline and actual fire
+  unsigned long maxLateness;
+  LatencyHistogram runTime;   // Time spent in the callback
+  std::function<void()> callback;
+} SchedulerJob;
+
+// Single owner of every App deadline.
+// Armed jobs are kept in a binary min-heap ordered by deadline, so update()
+// costs one comparison when nothing is due. Jobs live in a fixed array,
+// nothing is allocated once they are registered.
+class Scheduler {
+    public:
+        Scheduler(){
+            for (unsigned int i = 0; i < SCHEDULER_MAX_JOBS; i++)
+              this->heapPos[i] = SCHEDULER_NO_JOB;
+        };
+
+        // Registers a job, it is not armed until start() is called
+        JobId add(const char * name, unsigned int type, unsigned long interval, std::function<void()> callback){
+            if (this->jobCount >= SCHEDULER_MAX_JOBS){
+              LOG_ERROR("Scheduler: too many jobs");
+              return SCHEDULER_NO_JOB;
+            }
+
+            JobId id = this->jobCount++;
+            SchedulerJob &job = this->jobs[id];
+            job.name = name;
+            job.type = type;
+            job.interval = interval;
+            job.startAt = 0;
+            job.deadline = 0;
+            job.fireCount = 0;
+            job.lastLateness = 0;
+            job.maxLateness = 0;
+            job.runTime = LatencyHistogram();
+            job.callback = callback;
+            return id;
+        };
+
+        JobId addWallClock(const char * name, unsigned int startAt, std::function<void()> callback){
+            JobId id = add(name, WALL_CLOCK, 0, callback);
+            if (id != SCHEDULER_NO_JOB)
+              this->jobs[id].startAt = startAt;
+            return id;
+        };
+
+        // Arms the job on its own interval (or next wall-clock occurrence) from now
+        void start(JobId id){
+            if (id >= this->jobCount)
+              return;
+            arm(id, get_time() + nextDelay(this->jobs[id]));
+        };
+
+        // Arms the job after delay seconds, the delay becomes the job interval
+        void start(JobId id, unsigned long delay){
+            if (id >= this->jobCount)
+              return;
+            this->jobs[id].interval = delay;
+            arm(id, get_time() + delay);
+        };
+
+        // Makes the job due on the next update()
+        void startNow(JobId id){
+            if (id >= this->jobCount)
+              return;
+            arm(id, get_time());
+        };
+
+        void pause(JobId id){
+            if (id >= this->jobCount || this->heapPos[id] == SCHEDULER_NO_JOB)
+              return;
+
+            uint8_t pos = this->heapPos[id];
+            this->heapPos[id] = SCHEDULER_NO_JOB;
+            this->heapSize--;
+            if (pos == this->heapSize)
+              return;
+
+            JobId moved = this->heap[this->heapSize];
+            this->heap[pos] = moved;
+            this->heapPos[moved] = pos;
+            siftUp(pos);
+            siftDown(this->heapPos[moved]);
+        };
+
+        bool paused(JobId id){
+            return id >= this->jobCount || this->heapPos[id] == SCHEDULER_NO_JOB;
+        };
+
+        unsigned long remainingTime(JobId id){
+            if (paused(id))
+              return 0;
+
+            unsigned long now = get_time();
+            unsigned long deadline = this->jobs[id].deadline;
+            return deadline > now ? deadline - now : 0;
+        };
+
+        void update(unsigned long time_sec){
+            // Bounded so a job re-arming itself in the past cannot starve loop()
+            for (unsigned int fired = 0; fired < SCHEDULER_MAX_JOBS; fired++){
+                if (this->heapSize == 0 || this->jobs[this->heap[0]].deadline > time_sec)
+                  return;
+
+                JobId id = this->heap[0];
+                SchedulerJob &job = this->jobs[id];
+
+                job.fireCount++;
+                job.lastLateness = time_sec - job.deadline;
+                if (job.lastLateness > job.maxLateness)
+                  job.maxLateness = job.lastLateness;
+
+                pause(id);
+                // Periodic jobs are re-armed first so the callback may still pause them
+                if (job.type != SINGLE_SHOT)
+                  arm(id, time_sec + nextDelay(job));
+
+                uint32_t start = ESP.getCycleCount();
+                job.callback();
+                job.runTime.recordSince(start);
+            }
+        };
+
+        unsigned int size(){
+            return this->jobCount;
+        };
+
+        const SchedulerJob & job(JobId id){
+            return this->jobs[id];
+        };
+
+    private:
+        SchedulerJob jobs[SCHEDULER_MAX_JOBS];
+        uint8_t jobCount = 0;
+        JobId heap[SCHEDULER_MAX_JOBS];
+        uint8_t heapSize = 0;
+        uint8_t heapPos[SCHEDULER_MAX_JOBS]; //Index of a job in heap, SCHEDULER_NO_JOB when paused
+
+        unsigned long nextDelay(const SchedulerJob &job){
+            if (job.type == WALL_CLOCK)
+              return FixedTimeTimer::secondsUntil(job.startAt);
+            return job.interval;
+        };
+
+        void arm(JobId id, unsigned long deadline){
+            pause(id);
+            this->jobs[id].deadline = deadline;
+            uint8_t pos = this->heapSize++;
+            this->heap[pos] = id;
+            this->heapPos[id] = pos;
+            siftUp(pos);
+        };
+
+        bool before(uint8_t a, uint8_t b){
+            return this->jobs[this->heap[a]].deadline < this->jobs[this->heap[b]].deadline;
+        };
+
+        void swap(uint8_t a, uint8_t b){
+            JobId tmp = this->heap[a];
+            this->heap[a] = this->heap[b];
+            this->heap[b] = tmp;
+            this->heapPos[this->heap[a]] = a;
+            this->heapPos[this->heap[b]] = b;
+        };
+
+        void siftUp(uint8_t pos){
+            while (pos > 0){
+                uint8_t parent = (pos - 1) / 2;
+                if (!before(pos, parent))
+                  return;
+                swap(pos, parent);
+                pos = parent;
+            }
+        };
+
+        void siftDown(uint8_t pos){
+            while (true){
+                uint8_t smallest = pos;
+                uint8_t left = 2 * pos + 1;
+                uint8_t right = left + 1;
+                if (left < this->heapSize && before(left, smallest))
+                  smallest = left;
+                if (right < this->heapSize && before(right, smallest))
+                  smallest = right;
+                if (smallest == pos)
+                  return;
+                swap(pos, smallest);
+                pos = smallest;
+            }
+        };
+};
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef WEB_SERVER_BACKEND_H
+#define WEB_SERVER_BACKEND_H
+
+// HTTP server under Webserver, chosen at build time with -DWEB_BACKEND_MULTI=1
+//   0: ESP8266WebServer, one client at a time, each response written to completion
+//   1: MultiWebServer, several clients multiplexed from loop()
+#ifndef WEB_BACKEND_MULTI
+#define WEB_BACKEND_MULTI 0
+#endif
+
+#include <ESP8266WebServer.h>
+
+#if WEB_BACKEND_MULTI
+#include "MultiWebServer.h"
+typedef MultiWebServer WebServerBackend;
+#else
+typedef ESP8266WebServer WebServerBackend;
+#endif
+
+#endif
@@ -5,9 +5,18 @@
 #include "config.h"
 #include "timer.h"
 #include "FixedTimeTimer.h"
+#include "Scheduler.h"
+#include "DayMask.h"
+#include "History.h"
+#include "Journal.h"
+#include "AdcSampler.h"
+#include "Fixed.h"
+#include "Log.h"
+#include "LatencyHistogram.h"
+#include "FixedVector.h"
 #include <ArduinoJson.h>
+#include <algorithm>
 #include <functional>
-#include <vector>
 #include <string>
 #include <time.h>   
 #include <OneWire.h>
@@ -20,29 +29,70 @@ typedef struct {
 } FilterPressureCal;
 
 typedef struct {
-  char on[6]; // 00:00 => 6char 
-  char off[6];
+  float temperature;
+  float buffer;
+  uint16_t adcValue;
+} PhCalibration;
+
+typedef struct {
+  uint16_t on; // Minutes since midnight
+  uint16_t off; // Inclusive
 } TableObject;
 
+// Capacities of the schedule model, configurations above them are rejected
+#define TIMETABLE_MAX_SLOTS 8 // Slots of a table, also the maximum splits of a band
+#define TEMPERATURE_MAX_BANDS 16
+#define SEASON_MAX 6
+
+typedef FixedVector<TableObject, TIMETABLE_MAX_SLOTS> TimeTable;
+
 typedef struct {
     float minT;
     float maxT;
     unsigned int splits;
     unsigned long duration;
-    std::vector<TableObject> table;
+    TimeTable table;
 } TemperatureObject;
 
 typedef struct {
     char name[20];
-    std::vector<unsigned int> months;
-    std::vector<TableObject> table;
+    FixedVector<uint8_t, 12> months;
+    TimeTable table;
 } SeasonObject;
 
+// Reads of one sensor on the 1-Wire bus, latencies go from request to result
+typedef struct {
+  const char * name;
+  unsigned long reads;
+  unsigned long failures;
+  unsigned long lastLatency; // us
+  unsigned long maxLatency; // us
+  LatencyHistogram busTime; // Blocking time of each bus transaction
+} SensorStats;
+
+#define SENSOR_DS18B20 0
+#define SENSOR_POOL_READER 1
+#define SENSOR_COUNT 2
+
+// Phases of loop(), timed by the sketch through App::recordLoopPhase()
+#define LOOP_PHASE_MDNS 0
+#define LOOP_PHASE_OTA 1
+#define LOOP_PHASE_HTTP 2
+#define LOOP_PHASE_APP 3
+#define LOOP_PHASE_LOG 4
+#define LOOP_PHASE_EVENTS 5
+#define LOOP_PHASE_PUSH 6
+#define LOOP_PHASES 7
+
+static const char * const loopPhaseNames[LOOP_PHASES] = {"mdns", "ota", "http", "app", "log", "events", "push"};
+
 typedef struct {
   float currentTemp;
   float rtlTemp;
-  float filterPressure;
-  float filterPressureVlt;
+  float filterPressure; // Smoothed
+  float filterPressureVlt; // Last single reading
+  float filterPressureNoise; // Same unit as filterPressure
+  unsigned long filterPressureSamples;
   float pHLevel;
   uint16_t pHRaw;
   float ORP_CL_BR;
@@ -50,11 +100,20 @@ typedef struct {
   float ambiantTemp;
   float waterLevel;
   bool isPumpActivated;
-  std::vector<TableObject> timetable;
+  TimeTable timetable;
   bool isManual;
   unsigned long lastTableUpdate;
 } State;
 
+// Parts of State that change together, reported by App::takeChangedParts()
+#define STATE_PUMP 0x01 // isPumpActivated
+#define STATE_MANUAL 0x02 // isManual and the remaining manual time
+#define STATE_TEMPERATURE 0x04 // rtlTemp
+#define STATE_WATER 0x08 // Pool reader: pH, ORP, ambient temperature, water level
+#define STATE_PRESSURE 0x10
+#define STATE_TIMETABLE 0x20 // timetable, currentTemp, lastTableUpdate, season and next transition
+#define STATE_ALL 0x3F
+
 
 
 class App{
@@ -63,69 +122,358 @@ class App{
         OneWire *oneWire;
         DallasTemperature *sensors;
         PoolReaderClient *poolReader;
-        State state;
-        Timer *pumpUpdateTimer;
-        FixedTimeTimer *timeTableUpdate;
-        DynamicJsonDocument * doc;
-        TemperatureObject currentTemperatureSlot;
-        SeasonObject currentSeasonSlot;
-        std::vector<TemperatureObject> temperatureTable;
-        std::vector<SeasonObject> seasonTable;
+        State state = {};
+        Scheduler scheduler;
+        JobId pumpUpdateJob;
+        JobId timeTableUpdateJob;
+        DayMask pumpMask;
+        const TemperatureObject * currentTemperatureSlot = nullptr; //Points into temperatureTable
+        const SeasonObject * currentSeasonSlot = nullptr; //Points into seasonTable
+        FixedVector<TemperatureObject, TEMPERATURE_MAX_BANDS> temperatureTable;
+        FixedVector<SeasonObject, SEASON_MAX> seasonTable;
+        int8_t seasonByMonth[12]; //Index in seasonTable for each tm_mon, -1 when unassigned
         FilterPressureCal filterSensorCal;
+        FixedLinear adcToVolt; //Precomputed from the calibration, see computeCalibrationCoefficients()
+        FixedLinear adcToPsi;
+        PhCalibration phCal;
+        HistoryTierConfig historyConfig[HISTORY_MAX_TIERS] = {{300, 2016}, {3600, 2016}, {86400, 1456}}; //12 h, 6 days, 104 days
+        uint8_t historyTierCount = 3;
+        AdcSampler pressureSampler = AdcSampler(GPIO_PRESSURE);
+        History history;
+        Journal journal;
+        JobId historyJob;
+        unsigned long configLoadMicros = 0;
+        DeviceAddress tempAddress;
+        bool tempAddressValid = false;
+        bool tempWanted = false; //Waiting for the bus to start a conversion
+        bool tempPending = false; //Conversion running, it holds the bus until collected
+        unsigned long tempRequestedAt = 0;
+        unsigned long tempWantedAt = 0; //us
+        bool poolReadWanted = false; //Waiting for the bus to read the pool reader
+        unsigned long poolReadWantedAt = 0; //us
+        SensorStats sensorStats[SENSOR_COUNT] = {{"ds18b20", 0, 0, 0, 0, {}}, {"pool_reader", 0, 0, 0, 0, {}}};
+        unsigned long tempConversionMs = 0;
+        unsigned long loopStallMax = 0; //Longest update() since boot, us
+        unsigned long loopStallWindowMax = 0; //Longest update() in the running minute, us
+        unsigned long loopStallRecent = 0; //Longest update() in the previous minute, us
+        unsigned long loopStallWindowStart = 0;
+        LatencyHistogram loopPhases[LOOP_PHASES];
+        uint32_t stateVersion = 1; //Bumped on every change of state or season, see getStateVersion()
+        uint8_t changedParts = 0; //STATE_* changed since the last takeChangedParts()
+        bool configFromImage = false;
         bool initialized = false;
-        Timer *watchDogTimer;
-        Timer *manualActivationTimer;
-        Timer *temperatureTimer;
-        Timer *waterMeasurmentTimer;
+        volatile bool clockChanged = false;
+        time_t nextPumpTransition = 0;
+        bool nextPumpState = false;
+        JobId watchDogJob;
+        JobId manualActivationJob;
+        JobId temperatureJob;
+        JobId waterMeasurmentJob;
 
 
         void readCalibrationData(JsonObject &root){
           //No Error Checking done ! Values must be present. 
           JsonObject calData = root["calibration"];
 
-          float bufferValue = calData["buffer"];
-          uint16_t adcValue = calData["adcValue"];
-          float temp = calData["temperature"];
+          this->phCal.buffer = calData["buffer"];
+          this->phCal.adcValue = calData["adcValue"];
+          this->phCal.temperature = calData["temperature"];
 
-          Serial.println("Setting calibration data: ");
-          Serial.println(" - Temperature: " + String(temp) );
-          Serial.println(" - Buffer solution value: " + String(bufferValue));
-          Serial.println(" - ADC value: "+ String(adcValue));
-          
-          poolReader->setCalibrationValue(temp, bufferValue, adcValue);
+          this->filterSensorCal.vltStart = calData["filterVltStart"];
+          this->filterSensorCal.vltStop = calData["filterVltStop"];
+          this->computeCalibrationCoefficients();
+        }
+
+        // Whole ADC count to PSI chain folded into one gain and offset, the sample path stays in fixed point
+        void computeCalibrationCoefficients(){
+          this->adcToVolt = FixedLinear::map(0, ADC_MAX_STEPS, 0, PWR_VLT);
+          float countsPerVolt = ADC_MAX_STEPS / PWR_VLT;
+          this->adcToPsi = FixedLinear::map(this->filterSensorCal.vltStart * countsPerVolt, this->filterSensorCal.vltStop * countsPerVolt, PRESSURE_MIN, PRESSURE_MAX);
+        }
+
+        // Optional "history": [{"period": s, "budget": bytes}, ...], finest tier first
+        void readHistoryConfig(JsonObject &root){
+          if (!root["history"].is<JsonArray>())
+            return;
+
+          JsonArray tiers = root["history"];
+          this->historyTierCount = 0;
+          for (JsonObject tier : tiers) {
+            if (this->historyTierCount == HISTORY_MAX_TIERS){
+              LOG_WARN("History: only %u tiers are kept", HISTORY_MAX_TIERS);
+              break;
+            }
+            this->historyConfig[this->historyTierCount].period = tier["period"];
+            this->historyConfig[this->historyTierCount].budget = tier["budget"];
+            this->historyTierCount++;
+          }
+        }
+
+        // Applying calibration to the PoolReader client, once it exists
+        void applyCalibrationData(){
+          LOG_INFO("pH calibration: temperature %.2f, buffer %.2f, ADC %d", this->phCal.temperature, this->phCal.buffer, this->phCal.adcValue);
+          poolReader->setCalibrationValue(this->phCal.temperature, this->phCal.buffer, this->phCal.adcValue);
+          LOG_INFO("Filter pressure calibration: %.2f V - %.2f V", this->filterSensorCal.vltStart, this->filterSensorCal.vltStop);
+        }
+
+        static void writeTable(ConfigImageWriter &out, const TimeTable &table){
+            out.put((uint8_t) table.size());
+            for (const TableObject &entry : table)
+              out.put(entry);
+        }
+
+        static bool readTable(ConfigImageReader &in, TimeTable &table){
+            uint8_t count;
+            if (!in.get(count) || !table.resize(count))
+              return false;
+            for (TableObject &entry : table)
+              in.get(entry);
+            return in.ok;
+        }
+
+        // Binary image of everything read from the JSON configuration, see ConfigImageHeader
+        bool writeConfigImage(const String &filename, uint32_t jsonSize, uint32_t jsonCrc){
+            File file = LittleFS.open(filename, "w+");
+            if (!file)
+              return false;
+
+            ConfigImageHeader header = {};
+            file.write((const uint8_t *) &header, sizeof(header));
+
+            ConfigImageWriter out(file);
+            out.put(this->phCal);
+            out.put(this->filterSensorCal);
+            out.put(this->historyTierCount);
+            for (uint8_t i = 0; i < this->historyTierCount; i++)
+              out.put(this->historyConfig[i]);
+
+            out.put((uint8_t) this->temperatureTable.size());
+            for (const TemperatureObject &band : this->temperatureTable){
+              out.put(band.minT);
+              out.put(band.maxT);
+              out.put((uint32_t) band.splits);
+              out.put((uint32_t) band.duration);
+              writeTable(out, band.table);
+            }
+
+            out.put((uint8_t) this->seasonTable.size());
+            for (const SeasonObject &season : this->seasonTable){
+              out.write(season.name, sizeof(season.name));
+              out.put((uint8_t) season.months.size());
+              for (uint8_t month : season.months)
+                out.put(month);
+              writeTable(out, season.table);
+            }
+
+            header.magic = CONFIG_IMAGE_MAGIC;
+            header.version = CONFIG_IMAGE_VERSION;
+            header.jsonSize = jsonSize;
+            header.jsonCrc = jsonCrc;
+            header.payloadSize = out.size;
+            header.payloadCrc = out.crc;
+            bool ok = out.ok && file.seek(0, SeekSet) && file.write((const uint8_t *) &header, sizeof(header)) == sizeof(header);
+            file.close();
+
+            if (!ok)
+              LittleFS.remove(filename);
+            return ok;
+        }
+
+        // Fails on any mismatch (magic, version, stale JSON, CRC), the caller then falls back to the JSON
+        bool readConfigImage(const String &filename, uint32_t jsonSize, uint32_t jsonCrc){
+            File file = LittleFS.open(filename, "r");
+            if (!file)
+              return false;
+
+            ConfigImageHeader header;
+            if (file.read((uint8_t *) &header, sizeof(header)) != sizeof(header)
+                || header.magic != CONFIG_IMAGE_MAGIC || header.version != CONFIG_IMAGE_VERSION
+                || header.jsonSize != jsonSize || header.jsonCrc != jsonCrc){
+              file.close();
+              return false;
+            }
+
+            // Calibration and history are only applied once the CRC matched, the JSON fallback may not set them again
+            ConfigImageReader in(file, header.payloadSize);
+            PhCalibration phCal;
+            FilterPressureCal filterSensorCal;
+            HistoryTierConfig historyConfig[HISTORY_MAX_TIERS];
+            in.get(phCal);
+            in.get(filterSensorCal);
+
+            uint8_t count = 0;
+            in.get(count);
+            uint8_t historyTierCount = count < HISTORY_MAX_TIERS ? count : HISTORY_MAX_TIERS;
+            for (uint8_t i = 0; i < historyTierCount; i++)
+              in.get(historyConfig[i]);
+
+            count = 0;
+            in.get(count);
+            if (!this->temperatureTable.resize(count))
+              in.ok = false;
+            for (TemperatureObject &band : this->temperatureTable){
+              uint32_t splits = 0, duration = 0;
+              in.get(band.minT);
+              in.get(band.maxT);
+              in.get(splits);
+              in.get(duration);
+              band.splits = splits;
+              band.duration = duration;
+              if (!readTable(in, band.table))
+                break;
+            }
+
+            count = 0;
+            in.get(count);
+            if (!this->seasonTable.resize(count))
+              in.ok = false;
+            for (SeasonObject &season : this->seasonTable){
+              uint8_t monthCount = 0;
+              in.read(season.name, sizeof(season.name));
+              season.name[sizeof(season.name) - 1] = '\0';
+              in.get(monthCount);
+              if (!season.months.resize(monthCount)){
+                in.ok = false;
+                break;
+              }
+              for (uint8_t &month : season.months)
+                in.get(month);
+              if (!readTable(in, season.table))
+                break;
+            }
+            file.close();
+
+            if (!in.ok || in.remaining != 0 || in.crc != header.payloadCrc){
+              this->temperatureTable.clear();
+              this->seasonTable.clear();
+              return false;
+            }
+            this->phCal = phCal;
+            this->filterSensorCal = filterSensorCal;
+            this->historyTierCount = historyTierCount;
+            memcpy(this->historyConfig, historyConfig, historyTierCount * sizeof(HistoryTierConfig));
+            this->computeCalibrationCoefficients();
+            // Still checked: the index is not stored and a bad image must not get past validation
+            return validateTemperatureTable() && buildSeasonIndex();
+        }
+
+        // Boot path: the binary image when it matches the JSON, otherwise the JSON which then regenerates the image
+        bool loadConfiguration(){
+            uint32_t start = ESP.getCycleCount();
+            String filename = ConfigurationFactory::getDefault();
+            String imageName = ConfigurationFactory::getImageName(filename);
+
+            uint32_t jsonSize = 0, jsonCrc = 0;
+            if (!ConfigurationFactory::jsonSignature(filename, jsonSize, jsonCrc)){
+              LOG_ERROR("Could not read configuration file '%s'", filename);
+              return false;
+            }
+
+            this->configFromImage = readConfigImage(imageName, jsonSize, jsonCrc);
+            if (!this->configFromImage){
+              LOG_INFO("Configuration image missing or stale, parsing JSON");
+              this->temperatureTable.clear();
+              this->seasonTable.clear();
+              DynamicJsonDocument doc(3072);
+              if(!ConfigurationFactory::loadConfig(filename, &doc)){
+                LOG_ERROR("Could not parse configuration file '%s'", filename);
+                return false;
+              }
+
+              JsonObject root = doc.as<JsonObject>();
+              if (!this->readTemperatureAndSeasonsTable(root)){
+                LOG_ERROR("Could not load timetable from configuration");
+                return false;
+              }
+              this->readCalibrationData(root);
+              this->readHistoryConfig(root);
+
+              if (!writeConfigImage(imageName, jsonSize, jsonCrc))
+                LOG_WARN("Could not write configuration image");
+            }
+
+            this->configLoadMicros = (ESP.getCycleCount() - start) / ESP.getCpuFreqMHz();
+            LOG_INFO("Configuration loaded from %s in %lu us", this->configFromImage ? "image" : "json", this->configLoadMicros);
+            return true;
+        }
+
+        // Bands must cover a continuous range: sorted by minT, each one starting where the previous ends
+        bool validateTemperatureTable(){
+            std::sort(temperatureTable.begin(), temperatureTable.end(), [](const TemperatureObject &a, const TemperatureObject &b){
+              return a.minT < b.minT;
+            });
+
+            for (unsigned int i = 0; i < temperatureTable.size(); i++) {
+                const TemperatureObject &band = temperatureTable[i];
+                if (band.minT >= band.maxT){
+                  LOG_ERROR("Temperature band %u: minT must be lower than maxT", i);
+                  return false;
+                }
+                if ((band.splits == 0 || band.duration == 0) && band.table.empty()){
+                  LOG_ERROR("Temperature band %u: needs splits and duration or a table", i);
+                  return false;
+                }
+                if (band.splits > TIMETABLE_MAX_SLOTS){
+                  LOG_ERROR("Temperature band %u: at most %u splits", i, TIMETABLE_MAX_SLOTS);
+                  return false;
+                }
+                if (i > 0 && band.minT != temperatureTable[i - 1].maxT){
+                  LOG_ERROR("Temperature band %u: %s with the previous band", i, band.minT > temperatureTable[i - 1].maxT ? "gap" : "overlap");
+                  return false;
+                }
+            }
+            return true;
+        }
 
-          Serial.println("Reading pressure sensor data...");
-          float filterVltStart = calData["filterVltStart"];
-          float filterVltStop = calData["filterVltStop"];
+        // Config months are 1..12, the index is addressed with tm_mon (0..11)
+        bool buildSeasonIndex(){
+            memset(this->seasonByMonth, -1, sizeof(this->seasonByMonth));
 
-          this->filterSensorCal.vltStart = filterVltStart;
-          this->filterSensorCal.vltStop = filterVltStop;
+            for (unsigned int i = 0; i < seasonTable.size(); i++) {
+                if (seasonTable[i].table.empty()){
+                  LOG_ERROR("Season %s has no table", seasonTable[i].name);
+                  return false;
+                }
+                for (unsigned int month : seasonTable[i].months) {
+                    if (month < 1 || month > 12){
+                      LOG_ERROR("Season %s: invalid month %u", seasonTable[i].name, month);
+                      return false;
+                    }
+                    if (this->seasonByMonth[month - 1] >= 0){
+                      LOG_ERROR("Month %u is in both %s and %s", month, seasonTable[this->seasonByMonth[month - 1]].name, seasonTable[i].name);
+                      return false;
+                    }
+                    this->seasonByMonth[month - 1] = i;
+                }
+            }
 
-          Serial.println("Setting Filter pressure calibration data: ");
-          Serial.println(" - Start voltage: " + String(this->filterSensorCal.vltStart) );
-          Serial.println(" - End voltage: " + String(this->filterSensorCal.vltStop));        
-           
+            for (unsigned int month = 0; month < 12; month++) {
+                if (this->seasonByMonth[month] < 0)
+                  LOG_WARN("Month %u has no season", month + 1);
+            }
+            return true;
         }
 
-        void readTemperatureAndSeasonsTable(JsonObject &root){
-            Serial.println("Reading Temperatures from Json");
+        bool readTemperatureAndSeasonsTable(JsonObject &root){
             JsonArray array = root["timetable"];
-            
-            Serial.print("Size of JsonArray");
-            Serial.println(array.size());
+            LOG_DEBUG("Reading %u temperature bands", array.size());
+
+            if (array.size() > TEMPERATURE_MAX_BANDS){
+              LOG_ERROR("At most %u temperature bands", TEMPERATURE_MAX_BANDS);
+              return false;
+            }
 
             for (JsonObject kv : array) {
-                Serial.println("1. Element of TimeTable");
-                
-                TemperatureObject temperatureObject;
+                this->temperatureTable.resize(this->temperatureTable.size() + 1);
+                TemperatureObject &temperatureObject = this->temperatureTable[this->temperatureTable.size() - 1];
                 temperatureObject.minT = kv["minT"];
                 temperatureObject.maxT = kv["maxT"];
                 temperatureObject.splits = kv["splits"];
                 temperatureObject.duration = kv["duration"];
+                if (temperatureObject.duration > DAY_H * HOUR_MIN * MIN_S)
+                  temperatureObject.duration = DAY_H * HOUR_MIN * MIN_S;
                 
-                Serial.print(temperatureObject.minT);
-                Serial.print(" - ");
-                Serial.println(temperatureObject.maxT);
+                LOG_DEBUG("Temperature band %.1f - %.1f", temperatureObject.minT, temperatureObject.maxT);
                 
                 JsonArray tableArray = kv["table"];
                 
@@ -133,47 +481,59 @@ class App{
                 for (JsonObject vv : tableArray){
                   
                   TableObject tableObject;
-                  strlcpy(tableObject.on, vv["on"], sizeof(tableObject.on));
-                  strlcpy(tableObject.off, vv["off"], sizeof(tableObject.off));  
+                  tableObject.on = timeToMinFromString(vv["on"] | "0:00");
+                  tableObject.off = timeToMinFromString(vv["off"] | "0:00");
                   
-                  temperatureObject.table.push_back(tableObject);
+                  if (!temperatureObject.table.push_back(tableObject)){
+                    LOG_ERROR("Temperature band %.1f - %.1f: at most %u slots", temperatureObject.minT, temperatureObject.maxT, TIMETABLE_MAX_SLOTS);
+                    return false;
+                  }
                 }
 
-                Serial.print("Done adding Temperature slot : ");
-                Serial.println(temperatureTable.size());
-                
-                temperatureTable.push_back(temperatureObject);
-
             }
 
-            Serial.println("Done Reading Temperatures from Json");
+            if (!validateTemperatureTable()){
+              LOG_ERROR("Invalid temperature table");
+              return false;
+            }
 
-            Serial.println("Reading Seasons from Json");
             JsonArray objects = root["whitehours"];
+            if (objects.size() > SEASON_MAX){
+              LOG_ERROR("At most %u seasons", SEASON_MAX);
+              return false;
+            }
             
             for (JsonObject kv : objects) {
   
-                SeasonObject seasonObject;
+                this->seasonTable.resize(this->seasonTable.size() + 1);
+                SeasonObject &seasonObject = this->seasonTable[this->seasonTable.size() - 1];
                 strlcpy( seasonObject.name, kv["name"], sizeof(seasonObject.name));
                 seasonObject.months.clear();
+                seasonObject.table.clear();
 
                 JsonArray months = kv["months"];
 
                 for(unsigned int v : months) {
-                  seasonObject.months.push_back(v);
+                  // Range is checked by buildSeasonIndex, a month listed twice fails there too
+                  if (!seasonObject.months.push_back(v > 255 ? 0 : v)){
+                    LOG_ERROR("Season %s: at most %u months", seasonObject.name, seasonObject.months.capacity());
+                    return false;
+                  }
                 }
                  
 
                 if (kv["table"].is<JsonArray>()) //In case table becom an array in the config
                 {
                   JsonArray tableArray = kv["table"];
-                  Serial.println("Adding elements");
                   for (JsonObject vv : tableArray){
                                        
                     TableObject tableObject;
-                    strlcpy(tableObject.on, vv["on"], sizeof(tableObject.on));
-                    strlcpy(tableObject.off, vv["off"], sizeof(tableObject.off));                    
-                    seasonObject.table.push_back(tableObject);
+                    tableObject.on = timeToMinFromString(vv["on"] | "0:00");
+                    tableObject.off = timeToMinFromString(vv["off"] | "0:00");
+                    if (!seasonObject.table.push_back(tableObject)){
+                      LOG_ERROR("Season %s: at most %u slots", seasonObject.name, TIMETABLE_MAX_SLOTS);
+                      return false;
+                    }
                   }
                 }
                 else
@@ -182,40 +542,36 @@ class App{
                   JsonObject vv = kv["table"];
 
                   TableObject tableObject;
-                  strlcpy(tableObject.on, vv["on"], sizeof(tableObject.on));
-                  strlcpy(tableObject.off, vv["off"], sizeof(tableObject.off));  
+                  tableObject.on = timeToMinFromString(vv["on"] | "0:00");
+                  tableObject.off = timeToMinFromString(vv["off"] | "0:00");
                   
                   seasonObject.table.push_back(tableObject);
                 }
                
-                Serial.print("Done Converting seasonJson : ");
-                Serial.println(seasonObject.table.size());
-
-                seasonTable.push_back(seasonObject);
+                LOG_DEBUG("Season %s: %u slots", seasonObject.name, seasonObject.table.size());
                 
             }
 
-            Serial.println("Done Reading Seasons from Json");
-
-
+            if (!buildSeasonIndex()){
+              LOG_ERROR("Invalid seasons table");
+              return false;
+            }
+            return true;
         };
         
     public:
         App(){
 
-            this->doc = new DynamicJsonDocument(3072);
-            if(!ConfigurationFactory::loadConfig(ConfigurationFactory::getDefault(), this->doc)){
-              Serial.println("Could not read Configuration file");
+            LOG_INFO("Schedule model uses %u bytes", (unsigned) scheduleModelBytes());
+            if (!this->loadConfiguration())
               return;
-            }
-            else{
-              Serial.println("Read back the configuration loaded");
-              serializeJsonPretty(*(this->doc), Serial);
-            }
-
 
-            JsonObject root = this->doc->as<JsonObject>();
-            this->readTemperatureAndSeasonsTable(root);
+            if (!this->history.begin(this->historyConfig, this->historyTierCount)){
+              LOG_ERROR("Invalid history configuration");
+              return;
+            }
+            LOG_INFO("History uses %u bytes", this->history.bytes());
+            this->journal.begin();
             
             pinMode(GPIO_RELAY, OUTPUT);
             digitalWrite(GPIO_RELAY, LOW);
@@ -224,175 +580,223 @@ class App{
             this->oneWire = new OneWire(GPIO_DS18B20);
             this->sensors = new DallasTemperature(oneWire);
             this->sensors->begin();
+            //Bus work is queued by requestTemp()/requestWaterMesurements() and run from serviceOneWireBus()
+            this->sensors->setWaitForConversion(false);
+            this->tempConversionMs = this->sensors->millisToWaitForConversion(this->sensors->getResolution());
+            this->tempAddressValid = this->sensors->getAddress(this->tempAddress, 0);
 
             this->poolReader = new PoolReaderClient(oneWire);
-            // Applying calibration from config to the PoolReader client
-            this->readCalibrationData(root);
+            this->applyCalibrationData();
             
             
-            //Start timers
-            this->pumpUpdateTimer =new Timer(Timer::getIntervalFromUnit(1, UNIT_MIN), LOOP_UNTIL_STOP);
-            this->pumpUpdateTimer->start();
-            
-            this->timeTableUpdate = new FixedTimeTimer( 0 , LOOP_UNTIL_STOP);
-            this->timeTableUpdate->start();
-
-            this->temperatureTimer = new Timer(Timer::getIntervalFromUnit(5, UNIT_MIN), LOOP_UNTIL_STOP);
-            this->temperatureTimer->start();
-
-            this->waterMeasurmentTimer = new Timer(Timer::getIntervalFromUnit(5, UNIT_MIN), LOOP_UNTIL_STOP);
-            this->waterMeasurmentTimer->start();
-
-            //initialize Manual timmers
-            this->manualActivationTimer = new Timer(Timer::getIntervalFromUnit(10, UNIT_D), SINGLE_SHOT);
-            this->watchDogTimer = new Timer(Timer::getIntervalFromUnit(10, UNIT_D), SINGLE_SHOT);
-
-
-            this->getTemp();
-            this->getWaterMesurements();
+            //Register jobs
+            //Pump deadline is armed on the next transition by onCheckPumpForUpdate
+            this->pumpUpdateJob = this->scheduler.add("pump", SINGLE_SHOT, 0, [this](){
+              if (!this->state.isManual)
+                this->onCheckPumpForUpdate();
+            });
+
+            this->timeTableUpdateJob = this->scheduler.addWallClock("timetable", 0, [this](){
+              if (!this->state.isManual)
+                this->onTimeTableUpdateFired();
+            });
+            this->scheduler.startNow(this->timeTableUpdateJob);
+
+            this->temperatureJob = this->scheduler.add("temperature", LOOP_UNTIL_STOP, Timer::getIntervalFromUnit(5, UNIT_MIN), [this](){
+              this->requestTemp();
+            });
+            this->scheduler.startNow(this->temperatureJob);
+
+            this->waterMeasurmentJob = this->scheduler.add("water", LOOP_UNTIL_STOP, Timer::getIntervalFromUnit(5, UNIT_MIN), [this](){
+              this->requestWaterMesurements();
+            });
+            this->scheduler.startNow(this->waterMeasurmentJob);
+
+            this->historyJob = this->scheduler.add("history", LOOP_UNTIL_STOP, HISTORY_SAMPLE_S, [this](){
+              this->recordHistory();
+            });
+            this->scheduler.start(this->historyJob);
+
+            //initialize Manual jobs, armed by enableManualPump
+            this->manualActivationJob = this->scheduler.add("manual", SINGLE_SHOT, Timer::getIntervalFromUnit(10, UNIT_D), [this](){
+              if (this->state.isManual)
+                this->disableManualPump();
+            });
+            this->watchDogJob = this->scheduler.add("watchdog", SINGLE_SHOT, Timer::getIntervalFromUnit(10, UNIT_D), [this](){
+              if (this->state.isManual)
+                this->disableManualPump();
+            });
+
+
+            //First reading is waited for, the first timetable update needs it
+            this->requestTemp();
+            this->startTempConversion();
+            delay(this->tempConversionMs);
+            this->collectTemp();
+            this->requestWaterMesurements();
+            this->readWaterMesurements();
             
             this->initialized = true;
         };
 
+        // Temperature bands, seasons and the current timetable, all inline in App
+        static constexpr size_t scheduleModelBytes(){
+            return sizeof(App::temperatureTable) + sizeof(App::seasonTable) + sizeof(State::timetable);
+        };
+
         State* getStatus(){
           return &(this->state);
         }
         
-        bool getCurrentTemperatureSlot(){
-            Serial.print("Getting temperature slot for value ");
-            Serial.println(this->state.currentTemp);
-            
-            for (TemperatureObject v : temperatureTable) {
-                if (this->state.currentTemp >= v.minT && this->state.currentTemp < v.maxT){
-                    Serial.print("Found ! ");
-                    Serial.print(v.minT);
-                    Serial.print(" - ");
-                    Serial.println(v.maxT);
-                    this->currentTemperatureSlot = v;
-                    return true;
-                }
+        // Binary search over the sorted, contiguous bands. Index or -1 when out of range
+        int findTemperatureSlot(float temperature){
+            int low = 0;
+            int high = (int) temperatureTable.size() - 1;
+            while (low <= high) {
+                int mid = (low + high) / 2;
+                const TemperatureObject &band = temperatureTable[mid];
+                if (temperature < band.minT)
+                  high = mid - 1;
+                else if (temperature >= band.maxT)
+                  low = mid + 1;
+                else
+                  return mid;
             }
-            return false;
+            return -1;
+        };
+
+        bool getCurrentTemperatureSlot(){
+            int index = findTemperatureSlot(this->state.currentTemp);
+            if (index < 0)
+              return false;
+
+            this->currentTemperatureSlot = &temperatureTable[index];
+            LOG_INFO("Temperature slot %d for %.2f", index, this->state.currentTemp);
+            return true;
 
         };
 
         bool getCurrentSeason(){
             unsigned int month = get_localtime()->tm_mon;
-            Serial.print("Finding season for current month ");
-            Serial.println(month);
-            for (SeasonObject kv : seasonTable) {
-                if (has_value(kv.months, month)){
-                    Serial.print("Found ");
-                    Serial.println(kv.name);
-                    this->currentSeasonSlot = kv;
-                    return true;
-                }
-            }
-            return false;
+            int index = this->seasonByMonth[month];
+            if (index < 0)
+              return false;
+
+            this->currentSeasonSlot = &seasonTable[index];
+            LOG_INFO("Found season %s", this->currentSeasonSlot->name);
+            return true;
         };
 
-        unsigned long computeAvailableSeasonTime(TableObject &t){
-            Serial.println("Computing available time between ");
-            Serial.print(t.on);
-            Serial.print(" - ");
-            Serial.println(t.off);
-            
-            unsigned long onTime = timeToSecFromString(t.on);
-            unsigned long offTime = timeToSecFromString(t.off);
-            return offTime - onTime;
+        unsigned long computeAvailableSeasonTime(const TableObject &t){
+            return ((unsigned long) t.off - t.on) * MIN_S;
         };
 
         void printTimeTable(){
-            Serial.println("Printing current Time table");
             unsigned int i = 1;
             for ( auto const &kv : this->state.timetable) {
-                char string[30];
-                sprintf(string, "%d. %s-%s", i, kv.on , kv.off);
-                Serial.println(string);
+                char on[6];
+                char off[6];
+                minToTimeString(kv.on, on);
+                minToTimeString(kv.off, off);
+                LOG_INFO("Timetable %u. %s-%s", i, on, off);
                 i++;
             }
         };
 
+        // Compiles state.timetable into the minute mask queried by isInTimeTable
+        void compileTimeTable(){
+            this->pumpMask.clear();
+            for (auto const &o : this->state.timetable) {
+                if (o.on <= o.off)
+                  this->pumpMask.setRange(o.on, o.off);
+            }
+        };
+
         void generateTable(){
-            Serial.println("Generating a new Time table !");
-            Serial.print("TT_Gen Size table season ");
-            Serial.println(this->currentSeasonSlot.table.size());
-            Serial.println(this->currentTemperatureSlot.duration);
-            Serial.println(this->currentTemperatureSlot.splits);
+            const TemperatureObject *slot = this->currentTemperatureSlot;
+            LOG_DEBUG("TT_Gen: season slots %u, duration %lu, splits %u", this->currentSeasonSlot->table.size(), slot->duration, slot->splits);
             
             this->state.timetable.clear();        
-            if ((this->currentTemperatureSlot.duration == 0 || this->currentTemperatureSlot.splits == 0) && !this->currentTemperatureSlot.table.empty()){
-                Serial.println("TT_Gen: Using Table");
-                this->state.timetable.insert(this->state.timetable.end(), this->currentTemperatureSlot.table.begin(),this->currentTemperatureSlot.table.end());
+            if ((slot->duration == 0 || slot->splits == 0) && !slot->table.empty()){
+                LOG_DEBUG("TT_Gen: Using Table");
+                this->state.timetable = slot->table;
+                this->compileTimeTable();
                 return;
             }
 
-            Serial.println("TT_Gen Gen table ");
-            if (this->currentTemperatureSlot.duration >= DAY_H * HOUR_MIN * MIN_S){
-                Serial.println("TT_Gen: Above 24H slot..");
-                this->currentTemperatureSlot.duration = DAY_H * HOUR_MIN * MIN_S;
-            }
-
-            Serial.println("TT_Gen 24h checked ");
             bool is24h = false;
 
             
             
-            unsigned long availableSeconds = computeAvailableSeasonTime(this->currentSeasonSlot.table.at(0));
-            Serial.print("TT_Gen: Have");
-            Serial.println(availableSeconds);
+            unsigned long availableSeconds = computeAvailableSeasonTime(this->currentSeasonSlot->table[0]);
+            LOG_DEBUG("TT_Gen: Have %lu s", availableSeconds);
             
-            if (this->currentTemperatureSlot.duration >= availableSeconds) {
-                Serial.println("Too much ours to place.");
-                Serial.println("Switching to 24h band");
+            if (slot->duration >= availableSeconds) {
+                LOG_INFO("Too many hours to place, switching to 24h band");
                 availableSeconds = DAY_H * HOUR_MIN * MIN_S;
                 is24h = true;
             }
 
-            Serial.println("TT_Gen: Compute ");
-            unsigned long splitedAvailableTime = availableSeconds / currentTemperatureSlot.splits;
+            unsigned long splitedAvailableTime = availableSeconds / slot->splits;
             unsigned long splitedAvailableTimeCenter = splitedAvailableTime / 2;
 
-            unsigned long splitsSlotDuration = currentTemperatureSlot.duration / currentTemperatureSlot.splits;
+            unsigned long splitsSlotDuration = slot->duration / slot->splits;
             unsigned long slotHalfDuration = splitsSlotDuration / 2;
             
             unsigned long startShift = 0;
             if (!is24h) {
-                startShift = timeToSecFromString(this->currentSeasonSlot.table.at(0).on);
-                Serial.print("TT_Gen: Start1 ");
-                Serial.println(startShift);
+                startShift = (unsigned long) this->currentSeasonSlot->table[0].on * MIN_S;
+                LOG_DEBUG("TT_Gen: Start1 %lu", startShift);
             }
 
-            Serial.println("TT_Gen: Building with iterations ");
+            // splits <= TIMETABLE_MAX_SLOTS, checked by validateTemperatureTable
             this->state.timetable.clear();
-            for (unsigned int i = 0; i< this->currentTemperatureSlot.splits; i++){
+            for (unsigned int i = 0; i< slot->splits; i++){
                 unsigned long startTime = i*splitedAvailableTime + startShift + splitedAvailableTimeCenter - slotHalfDuration;
                 unsigned long endTime = startTime + splitsSlotDuration;
 
                 TableObject o;
                 
-                secToTimeString(startTime, o.on);
-                secToTimeString(endTime, o.off );
+                o.on = (startTime >= DAY_MIN * MIN_S) ? DAY_MIN - 1 : startTime / MIN_S;
+                o.off = (endTime >= DAY_MIN * MIN_S) ? DAY_MIN - 1 : endTime / MIN_S;
 
                 this->state.timetable.push_back(o);
     
             }
 
+            this->compileTimeTable();
+
         };
 
-        void getWaterMesurements(){
-          Serial.println("Reading ORP, PH, WaterLevel, Ambiant Temperature");
-          if (!poolReader->read())
+        void recordSensorRead(uint8_t sensor, bool ok, unsigned long latency){
+          SensorStats &stats = this->sensorStats[sensor];
+          stats.reads++;
+          if (!ok)
+            stats.failures++;
+          stats.lastLatency = latency;
+          if (latency > stats.maxLatency)
+            stats.maxLatency = latency;
+        }
+
+        // Pool reader read is queued, serviceOneWireBus() runs it when the bus is free
+        void requestWaterMesurements(){
+          if (this->poolReadWanted)
+            return;
+          this->poolReadWanted = true;
+          this->poolReadWantedAt = micros();
+        }
+
+        void readWaterMesurements(){
+          this->poolReadWanted = false;
+          bool ok = poolReader->read();
+          recordSensorRead(SENSOR_POOL_READER, ok, micros() - this->poolReadWantedAt);
+          if (!ok)
           {
-            Serial.println("Error while reading 1-Wire sensor");
+            LOG_WARN("Error while reading 1-Wire sensor");
             return;
           }
-        
-          Serial.println("Got Temp: " + String(poolReader->getTemperature()) );
-          Serial.println("Got Ph  : " + String(poolReader->getPh()));
-          Serial.println("Got WL  : " + String(poolReader->getWaterLevel()));
-          Serial.println("Got ORP : " + String(poolReader->getOrp()));
-          Serial.println("Got Interval : " + String(poolReader->getSampleInterval()));
+
+          LOG_DEBUG("Pool reader: T %.2f pH %.2f WL %.2f ORP %.2f", poolReader->getTemperature(), poolReader->getPh(), poolReader->getWaterLevel(), poolReader->getOrp());
 
           this->state.pHLevel = poolReader->getPh();
           this->state.pHRaw = poolReader->getPhRaw();
@@ -400,95 +804,104 @@ class App{
           this->state.ORPRaw = poolReader->getOrpRaw();
           this->state.ambiantTemp = poolReader->getTemperature();
           this->state.waterLevel = poolReader->getWaterLevel();
-
+          this->stateChanged(STATE_WATER);
         }
 
-        void getTemp(){
-            Serial.print("Requesting temperatures...");
+        // Conversion is queued, serviceOneWireBus() starts it and collects it once tempConversionMs elapsed
+        void requestTemp(){
+            if (this->tempWanted || this->tempPending)
+              return;
+            this->tempWanted = true;
+            this->tempWantedAt = micros();
+        };
+
+        void startTempConversion(){
+            this->tempWanted = false;
             this->sensors->requestTemperatures(); // Send the command to get temperatures
-            Serial.println("DONE");
-            float tempC = this->sensors->getTempCByIndex(0);
+            this->tempRequestedAt = millis();
+            this->tempPending = true;
+        };
+
+        void collectTemp(){
+            this->tempPending = false;
+            //Address resolved once at boot, saves a bus search per reading
+            //Raw reading is in 1/128 C
+            int32_t raw = this->tempAddressValid ? this->sensors->getTemp(this->tempAddress) : (int32_t) (this->sensors->getTempCByIndex(0) * 128);
+            bool ok = raw != DEVICE_DISCONNECTED_RAW && raw != DEVICE_DISCONNECTED_C * 128;
+            recordSensorRead(SENSOR_DS18B20, ok, micros() - this->tempWantedAt);
 
             // Check if reading was successful
-            if(tempC != DEVICE_DISCONNECTED_C) 
+            if(ok) 
             {
-                Serial.print("Temperature for the device 1 (index 0) is: ");
-                Serial.println(tempC);
+                float tempC = Fixed::fromQ(raw, 7).toFloat();
+                LOG_DEBUG("Water temperature %.2f", tempC);
                 this->state.rtlTemp = tempC;
-
-                Serial.print("Set ");
-                Serial.println(this->state.rtlTemp);
+                this->stateChanged(STATE_TEMPERATURE);
             } 
             else
             {
-                Serial.println("Error: Could not read temperature data");
+                LOG_WARN("Could not read temperature data");
             }
         };
 
-        void getFilterPressure(){
-            Serial.println("Reading pressure voltage...");
-            int raw = analogRead(GPIO_PRESSURE);
-
-            float rawVlt = mapfloat(raw, 0, ADC_MAX_STEPS, 0, PWR_VLT);
-            float psiReading = mapfloat(rawVlt-this->filterSensorCal.vltStart, 0, this->filterSensorCal.vltStop - this->filterSensorCal.vltStart, PRESSURE_MIN, PRESSURE_MAX); 
-            float asBar = PSI_BAR_UNIT * psiReading;
+        void recordHistory(){
+            float values[HISTORY_METRICS];
+            values[HISTORY_WATER_TEMPERATURE] = this->state.rtlTemp;
+            values[HISTORY_AMBIENT_TEMPERATURE] = this->state.ambiantTemp;
+            values[HISTORY_PH] = this->state.pHLevel;
+            values[HISTORY_ORP] = this->state.ORP_CL_BR;
+            values[HISTORY_WATER_LEVEL] = this->state.waterLevel;
+            values[HISTORY_FILTER_PRESSURE] = this->state.filterPressure;
+            values[HISTORY_PUMP] = this->state.isPumpActivated ? 1 : 0;
+            this->history.add(get_time(), values);
+
+            HistoryRow row;
+            History::pack(values, row);
+            this->journal.append(get_time(), row);
+        }
 
-            Serial.println("Pressure reading: " + String(rawVlt)  + "V <=> " + String(psiReading) + " PSI");
-            this->state.filterPressure = psiReading;
-            this->state.filterPressureVlt = rawVlt;
+        // Called after each burst of pressureSampler
+        void publishFilterPressure(){
+            //State keeps floats for the API, converted once here
+            this->state.filterPressure = this->adcToPsi.apply(this->pressureSampler.getSmoothed(), ADC_Q).toFloat();
+            this->state.filterPressureVlt = this->adcToVolt.apply(this->pressureSampler.getLast(), 0).toFloat();
+            this->state.filterPressureNoise = this->adcToPsi.scale(this->pressureSampler.getNoise(), ADC_Q).toFloat();
+            this->state.filterPressureSamples = this->pressureSampler.getSamples();
+            this->stateChanged(STATE_PRESSURE);
         }
 
         void onTimeTableUpdateFired(){
-            Serial.println("Updating timetable...");
+            LOG_INFO("Updating timetable");
             // Get temp from rtlTemp
-            this->state.lastTableUpdate = time(NULL);
+            this->state.lastTableUpdate = get_time();
             this->state.currentTemp = this->state.rtlTemp;
+            this->stateChanged(STATE_TIMETABLE);
             
             if (!getCurrentTemperatureSlot()){
-              Serial.println("Could not find temperature slot");
+              LOG_WARN("Could not find temperature slot");
               return;
             }
             
             if (!getCurrentSeason()){
-              Serial.println("Could not find a season");
+              LOG_WARN("Could not find a season");
               return;
             }
             
             this->generateTable();
             this->printTimeTable();
             this->onCheckPumpForUpdate();
-            Serial.println("Table fully updated ! ");
         };
 
         bool isInTimeTable(unsigned int hour, unsigned int minutes){
-            unsigned long currentSec =  MIN_S * minutes + hour * HOUR_MIN * MIN_S;
-
-            for (TableObject o : this->state.timetable) {
-                unsigned long onSec = timeToSecFromString(o.on);
-                unsigned long offSec = timeToSecFromString(o.off);
-                
-                if (currentSec >= onSec && currentSec <= offSec){
-                    Serial.print("In ");
-                    Serial.print(o.on);
-                    Serial.print(" - ");
-                    Serial.print(o.off);
-                    Serial.print(" Time  ");
-                    Serial.print(hour);
-                    Serial.print(" - ");
-                    Serial.print(minutes);
-                    Serial.print(" - ");
-                    Serial.println(currentSec);
-                    return true;
-                }
-            }
-            return false;
+            return this->pumpMask.test(hour * HOUR_MIN + minutes);
         };
 
         void setPumpOn(){
             if (this->state.isPumpActivated)
               return;
             this->state.isPumpActivated = true;
-            Serial.println("Switching pump on");
+            this->stateChanged(STATE_PUMP);
+            LOG_INFO("Switching pump on");
             digitalWrite(GPIO_RELAY, HIGH);   
         };
 
@@ -497,16 +910,15 @@ class App{
               return;
 
             this->state.isPumpActivated = false;
-            Serial.println("Switching pump off");
+            this->stateChanged(STATE_PUMP);
+            LOG_INFO("Switching pump off");
             digitalWrite(GPIO_RELAY, LOW);
         };
 
         void onCheckPumpForUpdate(){
-            Serial.println("Checking pump status....");
             tm *completeTime = get_localtime();
-            time_t now = time(NULL);
-            Serial.print("Current Time is : ");
-            Serial.println(ctime(&now));
+            time_t now = get_time();
+            LOG_DEBUG("Checking pump at %02d:%02d:%02d", completeTime->tm_hour, completeTime->tm_min, completeTime->tm_sec);
 
             if (this->isInTimeTable(completeTime->tm_hour, completeTime->tm_min)){
                 setPumpOn();
@@ -514,33 +926,73 @@ class App{
             else{
                 setPumpOff();
             }
-            
-            Serial.println("Pump checked !");
+
+            this->armNextPumpTransition(completeTime, now);
         };
 
+        // Arms pumpUpdateJob on the exact second of the next on/off change
+        void armNextPumpTransition(const tm *completeTime, time_t now){
+            unsigned int minute = completeTime->tm_hour * HOUR_MIN + completeTime->tm_min;
+            int minutesToChange = this->pumpMask.nextChange(minute);
+
+            this->scheduler.pause(this->pumpUpdateJob);
+            time_t transition = 0;
+            bool state = this->nextPumpState;
+            unsigned long delay = 0;
+            // Below zero: same state all day long, the midnight table update will re-arm us
+            if (minutesToChange >= 0){
+                delay = (unsigned long) minutesToChange * MIN_S - completeTime->tm_sec;
+                transition = now + delay;
+                state = !this->pumpMask.test(minute);
+            }
+
+            // Re-armed on every clock sync, which mostly lands on the same switch
+            if (transition != this->nextPumpTransition || state != this->nextPumpState)
+                this->stateChanged(STATE_TIMETABLE);
+            this->nextPumpTransition = transition;
+            this->nextPumpState = state;
+
+            if (minutesToChange >= 0)
+                this->scheduler.start(this->pumpUpdateJob, delay);
+        };
+
+        void stateChanged(uint8_t parts){
+          this->stateVersion++;
+          this->changedParts |= parts;
+        }
+
+        // Timestamp of the next planned pump switch, 0 if none is planned
+        time_t getNextPumpTransition(){
+          if (this->state.isManual)
+            return 0;
+          return this->nextPumpTransition;
+        }
+
+        bool getNextPumpState(){
+          return this->nextPumpState;
+        }
+
+        // May be called from the SNTP callback, the work is deferred to update()
+        void notifyClockChanged(){
+          this->clockChanged = true;
+        }
+
 
         void enableManualPump(unsigned long duration_s, bool on){
-            Serial.println("Enabling watchdog manual");
+            LOG_INFO("Manual pump %s for %lu s", on ? "on" : "off", duration_s);
+            this->scheduler.start(this->manualActivationJob, Timer::getIntervalFromUnit(duration_s, UNIT_S));
 
-            this->manualActivationTimer->pause();
-            this->manualActivationTimer->setInterval(Timer::getIntervalFromUnit(duration_s, UNIT_S));
-            this->manualActivationTimer->start(true);
-            Serial.println("Updated timer manual");
-            
             enableManualPump(on);
 
         }
 
         void enableManualPump(bool on){
 
-            Serial.println("Enabling watchdog manual");
-
-            this->watchDogTimer->pause();
-            this->watchDogTimer->setInterval(Timer::getIntervalFromUnit(10, UNIT_D));
-            this->watchDogTimer->start(true);
+            LOG_INFO("Manual mode, pump %s", on ? "on" : "off");
+            this->scheduler.start(this->watchDogJob, Timer::getIntervalFromUnit(10, UNIT_D));
             
             this->state.isManual = true;
-            Serial.println("Watchdog created");
+            this->stateChanged(STATE_MANUAL);
             
             if (on)
               setPumpOn();
@@ -552,68 +1004,159 @@ class App{
           if (!this->state.isManual)
             return 0;
 
-          unsigned long watchDogRemaining = this->watchDogTimer->remainingTime();
-          unsigned long manualActivationTimerRemain = this->manualActivationTimer->remainingTime();
+          unsigned long watchDogRemaining = this->scheduler.remainingTime(this->watchDogJob);
+          unsigned long manualActivationTimerRemain = this->scheduler.remainingTime(this->manualActivationJob);
           
 
-          return this->manualActivationTimer->paused() ? watchDogRemaining : ((watchDogRemaining > manualActivationTimerRemain)? manualActivationTimerRemain : watchDogRemaining);
+          return this->scheduler.paused(this->manualActivationJob) ? watchDogRemaining : ((watchDogRemaining > manualActivationTimerRemain)? manualActivationTimerRemain : watchDogRemaining);
           
         }
 
         void disableManualPump(){
          if(!this->state.isManual)
          {
-          Serial.println("not in manual mode");
+          LOG_DEBUG("Not in manual mode");
          }
-         Serial.println("Disabling Manual mode");
+         LOG_INFO("Disabling manual mode");
           
-         this->watchDogTimer->pause();
-         this->manualActivationTimer->pause();
+         this->scheduler.pause(this->watchDogJob);
+         this->scheduler.pause(this->manualActivationJob);
           
 
-         Serial.println("Changing pump status");
          setPumpOff();
           
          this->state.isManual = false;
+         this->stateChanged(STATE_MANUAL);
          onTimeTableUpdateFired();
         }
 
-        SeasonObject  * getSeason(){
-          return &(this->currentSeasonSlot);
+        // nullptr until the first table update found a season
+        const SeasonObject * getSeason(){
+          return this->currentSeasonSlot;
+        }
+
+        Scheduler * getScheduler(){
+          return &(this->scheduler);
+        }
+
+        // Boot time spent loading the configuration, in microseconds
+        unsigned long getConfigLoadMicros(){
+          return this->configLoadMicros;
+        }
+
+        const History & getHistory(){
+          return this->history;
+        }
+
+        Journal & getJournal(){
+          return this->journal;
+        }
+
+        // Samples still in RAM are written, before a reboot or an update
+        void flushJournal(){
+          if (this->initialized)
+            this->journal.flush();
+        }
+
+        // Changes whenever something reported by /api/status does, except the clock-derived fields
+        uint32_t getStateVersion(){
+          return this->stateVersion;
+        }
+
+        // STATE_* parts changed since the previous call
+        uint8_t takeChangedParts(){
+          uint8_t parts = this->changedParts;
+          this->changedParts = 0;
+          return parts;
+        }
+
+        bool isConfigFromImage(){
+          return this->configFromImage;
         }
 
         void update(){
             if (!this->initialized)
               return;
 
-            unsigned long time_sec = time(NULL);
-            
-            if (this->state.isManual){
-
-              //If watchDog wakes up or manual is expired !
-              if (watchDogTimer->update(time_sec) || manualActivationTimer->update(time_sec)){
-                disableManualPump();
+            if (this->clockChanged){
+              //Wall clock moved: every deadline computed from it is stale
+              this->clockChanged = false;
+              if (this->state.lastTableUpdate != 0){ //Otherwise the first table update is still pending
+                this->scheduler.start(this->timeTableUpdateJob);
+                if (!this->state.isManual)
+                  this->onCheckPumpForUpdate();
               }
-              
-            } else {
-              if (pumpUpdateTimer->update(time_sec))
-                onCheckPumpForUpdate();
-            
-              if (timeTableUpdate->update(time_sec))
-                onTimeTableUpdateFired();  
             }
 
-            if (this->temperatureTimer->update(time_sec)){
-                this->getTemp();
-                this->getFilterPressure();
-            }
-              
+            unsigned long start = micros();
 
-            if (this->waterMeasurmentTimer->update(time_sec))
-                this->getWaterMesurements();
-            
+            this->scheduler.update(get_time());
+            this->serviceOneWireBus();
+            if (this->pressureSampler.update(millis()))
+              this->publishFilterPressure();
+
+            recordLoopStall(micros() - start, millis());
     }
 
+        // DS18B20 and pool reader share oneWire: at most one transaction per pass, and nothing
+        // else on the bus while a conversion runs (it must stay idle in parasite power mode)
+        void serviceOneWireBus(){
+            uint32_t start = ESP.getCycleCount();
+            uint8_t sensor;
+            if (this->tempPending){
+              if (millis() - this->tempRequestedAt < this->tempConversionMs)
+                return;
+              this->collectTemp();
+              sensor = SENSOR_DS18B20;
+            }
+            else if (this->tempWanted){
+              this->startTempConversion();
+              sensor = SENSOR_DS18B20;
+            }
+            else if (this->poolReadWanted){
+              this->readWaterMesurements();
+              sensor = SENSOR_POOL_READER;
+            }
+            else
+              return;
+            this->sensorStats[sensor].busTime.recordSince(start);
+        }
+
+        const SensorStats & getSensorStats(uint8_t sensor){
+          return this->sensorStats[sensor];
+        }
+
+        void recordLoopStall(unsigned long duration, unsigned long now){
+            if (duration > this->loopStallMax)
+              this->loopStallMax = duration;
+            if (duration > this->loopStallWindowMax)
+              this->loopStallWindowMax = duration;
+            if (now - this->loopStallWindowStart >= 60000){
+              this->loopStallRecent = this->loopStallWindowMax;
+              this->loopStallWindowMax = 0;
+              this->loopStallWindowStart = now;
+            }
+        }
+
+        // Time since the start cycle count goes to the phase, returns the current cycle count
+        uint32_t recordLoopPhase(uint8_t phase, uint32_t start){
+            return this->loopPhases[phase].recordSince(start);
+        }
+
+        const LatencyHistogram & getLoopPhase(uint8_t phase){
+            return this->loopPhases[phase];
+        }
+
+        // Longest update() pass since boot, in microseconds
+        unsigned long getLoopStallMax(){
+          return this->loopStallMax;
+        }
+
+        // Longest update() pass during the previous minute, in microseconds
+        unsigned long getLoopStallRecent(){
+          return this->loopStallRecent;
+        }
+
 };
 
 #endif
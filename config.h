@@ -6,6 +6,19 @@
 #include <ArduinoJson.h>
 #include <FS.h>
 #include <LittleFS.h>
+#include "Log.h"
+
+// CRC-32 (IEEE), bitwise to keep the table out of RAM
+uint32_t ConfigurationFactory_crc32(const void * data, size_t size, uint32_t crc = 0){
+  const uint8_t * bytes = (const uint8_t *) data;
+  crc = ~crc;
+  while (size--) {
+    crc ^= *bytes++;
+    for (uint8_t bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
 
 #define POOL_FW_VERSION __DATE__
 #define GPIO_RELAY 4 //D2
@@ -23,13 +36,81 @@
 
 #define FILENAME_LEN 64
 
+#define CONFIG_IMAGE_MAGIC 0x47464350 // "PCFG"
+#define CONFIG_IMAGE_VERSION 2
+#define CONFIG_IMAGE_EXT ".bin"
+
+// Header of the compiled configuration stored next to the JSON file.
+// The image is only trusted when the JSON size and CRC still match.
+typedef struct {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t jsonSize;
+  uint32_t jsonCrc;
+  uint32_t payloadSize;
+  uint32_t payloadCrc;
+} ConfigImageHeader;
+
+// Appends fields to a configuration image while tracking size and CRC
+class ConfigImageWriter {
+    public:
+        ConfigImageWriter(File &file) : file(file) {};
+
+        template <typename T>
+        void put(const T &value){
+            write(&value, sizeof(T));
+        };
+
+        void write(const void * data, size_t size){
+            if (this->file.write((const uint8_t *) data, size) != size)
+              this->ok = false;
+            this->crc = ConfigurationFactory_crc32(data, size, this->crc);
+            this->size += size;
+        };
+
+        bool ok = true;
+        uint32_t crc = 0;
+        uint32_t size = 0;
+
+    private:
+        File &file;
+};
+
+// Reads fields back from a configuration image, bounded by the payload size
+class ConfigImageReader {
+    public:
+        ConfigImageReader(File &file, uint32_t size) : remaining(size), file(file) {};
+
+        template <typename T>
+        bool get(T &value){
+            return read(&value, sizeof(T));
+        };
+
+        bool read(void * data, size_t size){
+            if (!this->ok || size > this->remaining || this->file.read((uint8_t *) data, size) != size){
+              this->ok = false;
+              return false;
+            }
+            this->crc = ConfigurationFactory_crc32(data, size, this->crc);
+            this->remaining -= size;
+            return true;
+        };
+
+        bool ok = true;
+        uint32_t crc = 0;
+        uint32_t remaining;
+
+    private:
+        File &file;
+};
+
 
 class ConfigurationFactory {
     public: 
         static bool loadConfig(String filename, DynamicJsonDocument * doc){
             if (!LittleFS.exists(filename)){
-                Serial.println("LoadConfig : Failed file does not exists");
-                Serial.println("'"+filename+"'");
+                LOG_ERROR("LoadConfig: file '%s' does not exist", filename);
                 return false;
             }
               
@@ -39,6 +120,28 @@ class ConfigurationFactory {
             return true;
         };
 
+        // Size and CRC of the JSON file, used to tell whether its binary image is stale
+        static bool jsonSignature(String filename, uint32_t &size, uint32_t &crc){
+            File file = LittleFS.open(filename, "r");
+            if (!file)
+              return false;
+
+            uint8_t buffer[64];
+            size = 0;
+            crc = 0;
+            size_t n;
+            while ((n = file.read(buffer, sizeof(buffer))) > 0) {
+              crc = ConfigurationFactory_crc32(buffer, n, crc);
+              size += n;
+            }
+            file.close();
+            return true;
+        };
+
+        static String getImageName(String filename){
+            return filename + CONFIG_IMAGE_EXT;
+        };
+
         static void writeConfig(String filename, JsonDocument &doc ){
             File file = LittleFS.open(filename, "w+");
             serializeJson(doc, file);
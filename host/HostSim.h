@@ -0,0 +1,54 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+// Shared setup of the host executables: each one is a single translation unit
+// including the sketch headers, exactly like the .ino on the device.
+
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "umm_malloc/umm_malloc.h"
+
+#define HOST_TZ "CET-1CEST,M3.5.0,M10.5.0/3" // TZ_Europe_Paris
+#define HOST_START_EPOCH 1622505600          // 2021-06-01 00:00 UTC
+
+time_t get_time() {
+  return HostHardware::epoch;
+}
+
+tm *get_localtime() {
+  time_t now = get_time();
+  return localtime(&now);
+}
+
+// Points LittleFS at fsDir, seeding it from the repository data/ folder when empty
+void hostSimSetup(const std::string &fsDir, time_t start = HOST_START_EPOCH) {
+  namespace stdfs = std::filesystem;
+
+  setenv("TZ", HOST_TZ, 1);
+  tzset();
+  HostHardware::epoch = start;
+  HostHardware::uptimeUs = 0;
+
+  std::error_code ec;
+  if (!stdfs::exists(fsDir, ec) || stdfs::is_empty(fsDir, ec)) {
+    stdfs::create_directories(fsDir, ec);
+    stdfs::copy(POOL_DATA_DIR, fsDir, stdfs::copy_options::recursive | stdfs::copy_options::overwrite_existing, ec);
+  }
+  LittleFS.setRoot(fsDir);
+  hostHeapReset(); // Heap used from here on is the sketch's
+}
+
+// Wall-clock nanoseconds spent in fn, the simulated clock is not involved
+template <typename F>
+uint64_t hostMeasureNs(F fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif
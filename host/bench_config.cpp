@@ -0,0 +1,48 @@
+// Boot-time cost of the configuration: JSON parse versus the cached binary image.
+// Each round constructs App twice, first with the image removed (JSON path,
+// regenerates the image) then with the image in place.
+
+#include "HostSim.h"
+#include "../consts.h"
+#include "../app.h"
+#include "../config.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+static void report(const char *name, std::vector<unsigned long> &samples) {
+  std::sort(samples.begin(), samples.end());
+  unsigned long total = 0;
+  for (unsigned long v : samples) total += v;
+  printf("  %-6s mean %8.1f us  median %6lu us  min %6lu us  max %6lu us\n", name,
+         (double) total / samples.size(), samples[samples.size() / 2], samples.front(), samples.back());
+}
+
+int main(int argc, char **argv) {
+  int rounds = argc > 1 ? atoi(argv[1]) : 50;
+  if (rounds < 1) rounds = 1;
+
+  hostSimSetup(argc > 2 ? argv[2] : "bench_config_fs");
+  String image = ConfigurationFactory::getImageName(ConfigurationFactory::getDefault());
+
+  std::vector<unsigned long> json, binary;
+  for (int i = 0; i < rounds; i++) {
+    LittleFS.remove(image);
+    App *fromJson = new App();
+    App *fromImage = new App();
+    if (fromJson->isConfigFromImage() || !fromImage->isConfigFromImage()) {
+      printf("Unexpected configuration source, is %s writable ?\n", image.c_str());
+      return 1;
+    }
+    json.push_back(fromJson->getConfigLoadMicros());
+    binary.push_back(fromImage->getConfigLoadMicros());
+    delete fromJson;
+    delete fromImage;
+  }
+
+  printf("Configuration load, %d rounds (%s):\n", rounds, image.c_str());
+  report("json", json);
+  report("image", binary);
+  return 0;
+}
@@ -0,0 +1,67 @@
+// Filter pressure conversion: float mapfloat() chain versus the precomputed
+// fixed-point coefficients used by App. Checks the accuracy of both against a
+// double reference over every Q8 ADC value, then times them.
+//
+// Timings are host nanoseconds from the steady clock. The host has an FPU, so
+// they only show the relative cost of the integer path: on the ESP8266 every
+// float operation is a soft-float call costing hundreds of cycles.
+
+#include "HostSim.h"
+#include "../consts.h"
+#include "../config.h"
+#include "../utils.h"
+#include "../Fixed.h"
+#include "../AdcSampler.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+
+#define VLT_START 0.31f
+#define VLT_STOP 3.0f
+
+static float floatPath(uint32_t countsQ8) {
+  float counts = countsQ8 / (float) (1 << ADC_Q);
+  float vlt = mapfloat(counts, 0, ADC_MAX_STEPS, 0, PWR_VLT);
+  return mapfloat(vlt - VLT_START, 0, VLT_STOP - VLT_START, PRESSURE_MIN, PRESSURE_MAX);
+}
+
+static double reference(uint32_t countsQ8) {
+  double vlt = countsQ8 / 256.0 * PWR_VLT / ADC_MAX_STEPS;
+  return (vlt - VLT_START) * (PRESSURE_MAX - PRESSURE_MIN) / (VLT_STOP - VLT_START) + PRESSURE_MIN;
+}
+
+template <typename F>
+static double nsPer(uint32_t rounds, F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < rounds; i++) fn(i);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+int main(int argc, char **argv) {
+  uint32_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 4000000;
+  const uint32_t maxQ8 = ADC_MAX_STEPS << ADC_Q;
+  float countsPerVolt = ADC_MAX_STEPS / PWR_VLT;
+  FixedLinear adcToPsi = FixedLinear::map(VLT_START * countsPerVolt, VLT_STOP * countsPerVolt, PRESSURE_MIN, PRESSURE_MAX);
+
+  double maxFloatError = 0, maxFixedError = 0;
+  for (uint32_t q = 0; q <= maxQ8; q++) {
+    double ref = reference(q);
+    maxFloatError = fmax(maxFloatError, fabs(floatPath(q) - ref));
+    maxFixedError = fmax(maxFixedError, fabs(adcToPsi.apply(q, ADC_Q).toFloat() - ref));
+  }
+  printf("Accuracy over %u Q8 ADC values (PSI, max abs error vs double):\n", maxQ8 + 1);
+  printf("  float  %.6f\n  fixed  %.6f\n", maxFloatError, maxFixedError);
+
+  volatile float floatSink;
+  volatile int32_t fixedSink;
+  double floatNs = nsPer(rounds, [&](uint32_t i) { floatSink = floatPath(i % maxQ8); });
+  double fixedNs = nsPer(rounds, [&](uint32_t i) { fixedSink = adcToPsi.apply(i % maxQ8, ADC_Q).raw; });
+  (void) floatSink;
+  (void) fixedSink;
+  printf("Cost per conversion, %u rounds (host ns, not ESP8266 cycles):\n", rounds);
+  printf("  float  %.2f\n  fixed  %.2f\n", floatNs, fixedNs);
+
+  // Fails the run when the fixed path drifts beyond the sensor resolution (0.1 PSI)
+  return maxFixedError < 0.01 ? 0 : 1;
+}
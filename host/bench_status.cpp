@@ -0,0 +1,87 @@
+// /api/status encodings: JSON against CBOR and MessagePack. Runs the
+// simulation for an hour so the state, timetable and season are filled, then
+// compares the response bodies served over HTTP and times each serialization.
+//
+// JSON is timed twice: rebuilt (first request after a state change) and
+// cached (the clock fields only, every other request). The compact encodings
+// have no cache, they are written from the App state on each request.
+// Timings are host nanoseconds from the steady clock: they only give the
+// relative cost, and depend on the ArduinoJson the host build was configured with.
+
+#include "HostSim.h"
+#include "../consts.h"
+#include "../app.h"
+#include "../config.h"
+#include "../utils.h"
+#include "../webserver.h"
+
+#include <stdio.h>
+#include <chrono>
+
+EspSaveCrash crashHandler(0, 3072);
+
+template <typename F>
+static double nsPer(uint32_t rounds, F fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < rounds; i++) fn(i);
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+// Body of GET /api/status with the given extra request headers
+static std::string fetch(Webserver *httpServer, const char *query, const char *headers) {
+  auto connection = HostNetwork::connect(80);
+  connection->peerWrite(std::string("GET /api/status") + query + " HTTP/1.1\r\nConnection: close\r\n" + headers + "\r\n");
+  std::string response;
+  for (int i = 0; i < 100 && !(connection->serverClosed && connection->toClient.empty()); i++) {
+    httpServer->handleClient();
+    response += connection->peerRead();
+    HostHardware::advanceMs(1);
+  }
+  size_t body = response.find("\r\n\r\n");
+  return body == std::string::npos ? std::string() : response.substr(body + 4);
+}
+
+int main(int argc, char **argv) {
+  uint32_t rounds = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000;
+  hostSimSetup(argc > 2 ? argv[2] : "/tmp/pool-bench-status-fs");
+  Log.setSerialLevel(LOG_LEVEL_ERROR);
+  App *app = new App();
+  Webserver *httpServer = new Webserver(app, &crashHandler, 80);
+  httpServer->begin();
+
+  for (int i = 0; i < 3600 * 10; i++) {
+    app->update();
+    Log.stream(Serial);
+    HostHardware::advanceMs(100);
+  }
+
+  std::string json = fetch(httpServer, "", "");
+  std::string cbor = fetch(httpServer, "", "Accept: application/cbor\r\n");
+  std::string msgpack = fetch(httpServer, "?format=msgpack", "");
+  if (json.empty() || cbor.empty() || msgpack.empty()) {
+    printf("GET /api/status failed\n");
+    return 1;
+  }
+  printf("/api/status body:\n");
+  printf("  json     %4zu B\n", json.size());
+  printf("  cbor     %4zu B  %3.0f%% of json\n", cbor.size(), 100.0 * cbor.size() / json.size());
+  printf("  msgpack  %4zu B  %3.0f%% of json\n", msgpack.size(), 100.0 * msgpack.size() / json.size());
+
+  uint8_t buffer[STATUS_COMPACT_MAX];
+  volatile size_t sink = 0;
+  char clock[96];
+  double rebuilt = nsPer(rounds, [&](uint32_t) { sink = httpServer->statusJson().length(); });
+  double cached = nsPer(rounds, [&](uint32_t) {
+    sink = snprintf(clock, sizeof(clock), "{\"currentTimestamp\":%lld,\"uptime\":%lu,\"remainingManualTime\":%lu,",
+                    (long long) get_time(), millis() / 1000, 0UL);
+  });
+  double cborNs = nsPer(rounds, [&](uint32_t) { sink = httpServer->statusCompact(buffer, sizeof(buffer), COMPACT_CBOR); });
+  double msgpackNs = nsPer(rounds, [&](uint32_t) { sink = httpServer->statusCompact(buffer, sizeof(buffer), COMPACT_MSGPACK); });
+  (void) sink;
+  printf("Serialization, %u rounds (host ns, not ESP8266 cycles):\n", rounds);
+  printf("  json rebuilt  %9.0f\n", rebuilt);
+  printf("  json cached   %9.0f  clock fields only\n", cached);
+  printf("  cbor          %9.0f  %5.1fx faster than rebuilt json\n", cborNs, rebuilt / cborNs);
+  printf("  msgpack       %9.0f  %5.1fx faster than rebuilt json\n", msgpackNs, rebuilt / msgpackNs);
+  return 0;
+}
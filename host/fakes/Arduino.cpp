@@ -0,0 +1,132 @@
+#include "Arduino.h"
+#include <chrono>
+#include "flash_hal.h"
+#include "umm_malloc/umm_malloc.h"
+
+time_t HostHardware::epoch = 0;
+uint64_t HostHardware::uptimeUs = 0;
+void (*HostHardware::onAdvance)(uint64_t us) = nullptr;
+uint8_t HostHardware::pinModes[HOST_GPIO_COUNT];
+uint8_t HostHardware::pinLevel[HOST_GPIO_COUNT];
+unsigned long HostHardware::pinWrites[HOST_GPIO_COUNT];
+int HostHardware::adcValue = 0;
+int HostHardware::adcNoise = 0;
+unsigned long HostHardware::adcReads = 0;
+float HostHardware::waterTemperature = 20.0f;
+unsigned long HostHardware::dallasRequests = 0;
+float HostHardware::ambientTemperature = 20.0f;
+float HostHardware::ph = 7.2f;
+uint16_t HostHardware::phRaw = 500;
+float HostHardware::orp = 650.0f;
+uint16_t HostHardware::orpRaw = 600;
+float HostHardware::waterLevel = 80.0f;
+bool HostHardware::poolReaderFails = false;
+unsigned long HostHardware::poolReaderReadUs = 30000;
+unsigned long HostHardware::poolReaderReads = 0;
+
+HardwareSerial Serial;
+bool HardwareSerial::echo = false;
+EspClass ESP;
+unsigned long EspClass::restartRequests = 0;
+UpdaterClass Update;
+
+extern "C" {
+uint32_t _FS_start = 0;
+uint32_t _FS_end = 0x100000;
+}
+
+void close_all_fs() {}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < HOST_GPIO_COUNT)
+    HostHardware::pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin >= HOST_GPIO_COUNT)
+    return;
+  HostHardware::pinLevel[pin] = value ? HIGH : LOW;
+  HostHardware::pinWrites[pin]++;
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < HOST_GPIO_COUNT ? HostHardware::pinLevel[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  (void) pin;
+  HostHardware::adcReads++;
+  HostHardware::advanceUs(100); // ESP8266 ADC conversion time
+  int value = HostHardware::adcValue;
+  if (HostHardware::adcNoise > 0)
+    value += (rand() % (2 * HostHardware::adcNoise + 1)) - HostHardware::adcNoise;
+  return std::max(0, std::min(1023, value));
+}
+
+unsigned long millis() {
+  return (unsigned long) (HostHardware::uptimeUs / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long) HostHardware::uptimeUs;
+}
+
+void delay(unsigned long ms) {
+  HostHardware::advanceMs(ms);
+}
+
+void delayMicroseconds(unsigned int us) {
+  HostHardware::advanceUs(us);
+}
+
+void yield() {}
+
+char *dtostrf(double number, signed char width, unsigned char prec, char *s) {
+  sprintf(s, "%*.*f", width, prec, number);
+  return s;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (echo)
+    fputc(c, stdout);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (echo)
+    fwrite(buffer, 1, size, stdout);
+  return size;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return hostHeapFree();
+}
+
+uint32_t EspClass::getMaxFreeBlockSize() {
+  return std::min<uint32_t>(getFreeHeap(), 32 * 1024);
+}
+
+uint8_t EspClass::getHeapFragmentation() {
+  uint32_t free = getFreeHeap();
+  return free ? 100 - (100 * getMaxFreeBlockSize()) / free : 100;
+}
+
+void EspClass::getHeapStats(uint32_t *free, uint16_t *max, uint8_t *frag) {
+  if (free) *free = getFreeHeap();
+  if (max) *max = getMaxFreeBlockSize();
+  if (frag) *frag = getHeapFragmentation();
+}
+
+uint32_t EspClass::getCycleCount() {
+  // Host CPU time plus the simulated delays, scaled to an 80 MHz cycle counter
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t) ((ns / 1000 + HostHardware::uptimeUs) * getCpuFreqMHz());
+}
+
+void EspClass::restart() {
+  restartRequests++;
+}
+
+void UpdaterClass::printError(Print &out) {
+  out.println(this->error ? "Update error" : "No error");
+}
@@ -0,0 +1,103 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal Arduino/ESP8266 core surface needed to build the sketch headers on Linux.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "HostHardware.h"
+#include "WString.h"
+#include "Print.h"
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const unsigned char *)(addr))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+#define A0 17
+
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+#if !(defined(__GLIBC__) && __GLIBC_PREREQ(2, 38)) // glibc ships strlcpy since 2.38
+inline size_t strlcpy(char *dst, const char *src, size_t size) {
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = len >= size ? size - 1 : len;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+#endif
+
+char *dtostrf(double number, signed char width, unsigned char prec, char *s);
+
+class HardwareSerial : public Stream {
+    public:
+        void begin(unsigned long baud) { (void) baud; }
+        void setDebugOutput(bool enabled) { (void) enabled; }
+
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *buffer, size_t size) override;
+        int available() override { return 0; }
+        int read() override { return -1; }
+        int peek() override { return -1; }
+        int availableForWrite() override { return 128; }
+
+        // Host only: Serial output is discarded unless enabled (keeps benchmarks honest)
+        static bool echo;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+    public:
+        uint32_t getFreeHeap();
+        uint32_t getMaxFreeBlockSize();
+        uint8_t getHeapFragmentation();
+        void getHeapStats(uint32_t *free, uint16_t *max, uint8_t *frag);
+        uint32_t getCycleCount();
+        uint8_t getCpuFreqMHz() { return 80; }
+        uint32_t getFreeSketchSpace() { return 1024 * 1024; }
+        uint32_t getChipId() { return 0x00C0FFEE; }
+        uint32_t random() { return (uint32_t) ::random(); }
+        void restart();
+
+        // Host only
+        static unsigned long restartRequests;
+};
+
+extern EspClass ESP;
+
+#include "Updater.h"
+
+#endif
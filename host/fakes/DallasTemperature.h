@@ -0,0 +1,68 @@
+#ifndef HOST_DALLASTEMPERATURE_H
+#define HOST_DALLASTEMPERATURE_H
+
+#include "Arduino.h"
+#include "OneWire.h"
+
+#define DEVICE_DISCONNECTED_C -127
+#define DEVICE_DISCONNECTED_RAW -7040
+
+typedef uint8_t DeviceAddress[8];
+
+// Single DS18B20 whose temperature is HostHardware::waterTemperature
+class DallasTemperature {
+    public:
+        DallasTemperature(OneWire *wire) { (void) wire; }
+
+        void begin() {}
+        uint8_t getDeviceCount() { return 1; }
+
+        bool getAddress(uint8_t *address, uint8_t index) {
+          if (index != 0) return false;
+          for (uint8_t i = 0; i < 8; i++) address[i] = i == 0 ? 0x28 : i;
+          return true;
+        }
+
+        void setResolution(uint8_t bits) { this->resolution = bits; }
+        uint8_t getResolution() { return this->resolution; }
+
+        void setWaitForConversion(bool wait) { this->waitForConversion = wait; }
+        bool getWaitForConversion() { return this->waitForConversion; }
+
+        int16_t millisToWaitForConversion(uint8_t bits) {
+          switch (bits) {
+            case 9: return 94;
+            case 10: return 188;
+            case 11: return 375;
+            default: return 750;
+          }
+        }
+        int16_t millisToWaitForConversion() { return millisToWaitForConversion(this->resolution); }
+
+        void requestTemperatures() {
+          HostHardware::dallasRequests++;
+          this->requestedAt = millis();
+          this->latched = HostHardware::waterTemperature;
+          if (this->waitForConversion)
+            delay(millisToWaitForConversion(this->resolution));
+        }
+
+        bool isConversionComplete() {
+          return millis() - this->requestedAt >= (unsigned long) millisToWaitForConversion(this->resolution);
+        }
+
+        int32_t getTemp(const uint8_t *address) {
+          (void) address;
+          return (int32_t) lroundf(this->latched * 128.0f);
+        }
+        float getTempC(const uint8_t *address) { return getTemp(address) / 128.0f; }
+        float getTempCByIndex(uint8_t index) { return index == 0 ? getTempC(nullptr) : DEVICE_DISCONNECTED_C; }
+
+    private:
+        uint8_t resolution = 12;
+        bool waitForConversion = true;
+        unsigned long requestedAt = 0;
+        float latched = DEVICE_DISCONNECTED_C;
+};
+
+#endif
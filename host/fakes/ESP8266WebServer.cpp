@@ -0,0 +1,343 @@
+#include "ESP8266WebServer.h"
+#include <strings.h>
+
+std::map<uint16_t, std::deque<std::shared_ptr<HostConnection>>> HostNetwork::pending;
+std::map<uint16_t, bool> HostNetwork::listening;
+std::vector<std::weak_ptr<HostConnection>> HostNetwork::open;
+
+void WiFiServer::begin() {
+  HostNetwork::listening[this->port] = true;
+}
+
+void WiFiServer::close() {
+  HostNetwork::listening[this->port] = false;
+}
+
+bool WiFiServer::hasClient() {
+  return !HostNetwork::pending[this->port].empty();
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  (void) host;
+  stop();
+  this->connection = HostNetwork::connect(port);
+  this->outgoing = true;
+  return this->connection ? 1 : 0;
+}
+
+WiFiClient WiFiServer::accept() {
+  auto &queue = HostNetwork::pending[this->port];
+  if (queue.empty())
+    return WiFiClient();
+  std::shared_ptr<HostConnection> connection = queue.front();
+  queue.pop_front();
+  return WiFiClient(connection);
+}
+
+namespace mime {
+String getContentType(const String &filename) {
+  static const char *const types[][2] = {
+    {".html", "text/html"}, {".htm", "text/html"}, {".css", "text/css"}, {".txt", "text/plain"},
+    {".js", "application/javascript"}, {".json", "application/json"}, {".png", "image/png"},
+    {".gif", "image/gif"}, {".jpg", "image/jpeg"}, {".ico", "image/x-icon"}, {".svg", "image/svg+xml"},
+    {".gz", "application/x-gzip"},
+  };
+  for (auto const &t : types)
+    if (filename.endsWith(t[0])) return t[1];
+  return "application/octet-stream";
+}
+} // namespace mime
+
+static const char *methodName(HTTPMethod method) {
+  switch (method) {
+    case HTTP_GET: return "GET";
+    case HTTP_HEAD: return "HEAD";
+    case HTTP_POST: return "POST";
+    case HTTP_PUT: return "PUT";
+    case HTTP_PATCH: return "PATCH";
+    case HTTP_DELETE: return "DELETE";
+    case HTTP_OPTIONS: return "OPTIONS";
+    default: return "ANY";
+  }
+}
+
+static HTTPMethod methodFromName(const String &name) {
+  const HTTPMethod all[] = {HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS};
+  for (HTTPMethod m : all)
+    if (name == methodName(m)) return m;
+  return HTTP_ANY;
+}
+
+static const char *statusText(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 500: return "Internal Server Error";
+    case 505: return "HTTP Version not supported";
+    default: return "";
+  }
+}
+
+ESP8266WebServer::ESP8266WebServer(int port) : server(port) {}
+
+void ESP8266WebServer::begin() {
+  this->server.begin();
+}
+
+void ESP8266WebServer::close() {
+  this->server.close();
+}
+
+void ESP8266WebServer::on(const String &uri, HTTPMethod method, THandlerFunction fn) {
+  on(uri, method, fn, THandlerFunction());
+}
+
+void ESP8266WebServer::on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction uploadFn) {
+  this->routes.push_back({uri, method, fn, uploadFn});
+}
+
+String ESP8266WebServer::arg(const String &name) const {
+  for (auto const &a : this->currentArgs)
+    if (a.first == name) return a.second;
+  return String();
+}
+
+String ESP8266WebServer::arg(int i) const {
+  return i < (int) this->currentArgs.size() ? this->currentArgs[i].second : String();
+}
+
+String ESP8266WebServer::argName(int i) const {
+  return i < (int) this->currentArgs.size() ? this->currentArgs[i].first : String();
+}
+
+bool ESP8266WebServer::hasArg(const String &name) const {
+  for (auto const &a : this->currentArgs)
+    if (a.first == name) return true;
+  return false;
+}
+
+String ESP8266WebServer::header(const String &name) const {
+  for (auto const &h : this->currentHeaders)
+    if (strcasecmp(h.first.c_str(), name.c_str()) == 0) return h.second;
+  return String();
+}
+
+bool ESP8266WebServer::hasHeader(const String &name) const {
+  for (auto const &h : this->currentHeaders)
+    if (strcasecmp(h.first.c_str(), name.c_str()) == 0) return true;
+  return false;
+}
+
+void ESP8266WebServer::sendHeader(const String &name, const String &value, bool first) {
+  if (first)
+    this->pendingHeaders.insert(this->pendingHeaders.begin(), {name, value});
+  else
+    this->pendingHeaders.push_back({name, value});
+}
+
+void ESP8266WebServer::send(int code, const char *contentType, const String &content) {
+  this->response.code = code;
+  this->response.contentType = contentType ? contentType : "text/html";
+  this->response.headers = this->pendingHeaders;
+  this->response.body.assign(content.c_str(), content.length());
+  this->pendingHeaders.clear();
+  this->responseStarted = true;
+}
+
+bool ESP8266WebServer::chunkedResponseModeStart(int code, const char *contentType) {
+  send(code, contentType, String());
+  this->response.chunked = true;
+  return true;
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t size) {
+  if (!this->responseStarted)
+    return;
+  if (!this->pendingHeaders.empty()) {
+    // Headers sent after the status line are ignored by the real server too
+    this->pendingHeaders.clear();
+  }
+  this->response.body.append(content, size);
+  if (this->response.chunked && size > 0)
+    this->response.chunks++;
+}
+
+void ESP8266WebServer::chunkedResponseFinalize() {}
+
+String ESP8266WebServer::urlDecode(const String &text) {
+  std::string out;
+  const std::string &in = text.std();
+  for (size_t i = 0; i < in.size(); i++) {
+    if (in[i] == '%' && i + 2 < in.size()) {
+      out += (char) strtol(in.substr(i + 1, 2).c_str(), nullptr, 16);
+      i += 2;
+    } else if (in[i] == '+') {
+      out += ' ';
+    } else {
+      out += in[i];
+    }
+  }
+  return String(out);
+}
+
+void ESP8266WebServer::prepare(HTTPMethod method, const String &uri, const String &body,
+                               const std::vector<std::pair<String, String>> &headers) {
+  this->currentMethod = method;
+  this->currentArgs.clear();
+  this->currentHeaders = headers;
+  this->pendingHeaders.clear();
+  this->response = HostResponse();
+  this->responseStarted = false;
+  this->clientTaken = false;
+  this->contentLength = CONTENT_LENGTH_NOT_SET;
+
+  int query = uri.indexOf('?');
+  this->currentUri = query < 0 ? uri : uri.substring(0, query);
+  if (query >= 0) {
+    String args = uri.substring(query + 1);
+    while (args.length()) {
+      int amp = args.indexOf('&');
+      String pair = amp < 0 ? args : args.substring(0, amp);
+      args = amp < 0 ? String() : args.substring(amp + 1);
+      int eq = pair.indexOf('=');
+      if (eq < 0)
+        this->currentArgs.push_back({urlDecode(pair), String()});
+      else
+        this->currentArgs.push_back({urlDecode(pair.substring(0, eq)), urlDecode(pair.substring(eq + 1))});
+    }
+  }
+  if (!body.isEmpty())
+    this->currentArgs.push_back({"plain", body});
+}
+
+ESP8266WebServer::Route *ESP8266WebServer::findRoute() {
+  for (auto &route : this->routes)
+    if (route.uri == this->currentUri && (route.method == HTTP_ANY || route.method == this->currentMethod))
+      return &route;
+  return nullptr;
+}
+
+void ESP8266WebServer::dispatch() {
+  Route *route = findRoute();
+  if (route)
+    route->fn();
+  else if (this->notFoundHandler)
+    this->notFoundHandler();
+}
+
+HostResponse ESP8266WebServer::hostRequest(HTTPMethod method, const String &uri, const String &body,
+                                           const std::vector<std::pair<String, String>> &headers) {
+  prepare(method, uri, body, headers);
+  this->currentClient = WiFiClient(std::make_shared<HostConnection>());
+  dispatch();
+  return std::exchange(this->response, HostResponse()); // Moved out, the body is not held between requests
+}
+
+HostResponse ESP8266WebServer::hostUpload(const String &uri, const String &field, const String &filename, const std::string &data) {
+  prepare(HTTP_POST, uri, String(), {});
+  this->currentClient = WiFiClient(std::make_shared<HostConnection>());
+  Route *route = findRoute();
+  if (!route) {
+    dispatch();
+    return std::exchange(this->response, HostResponse()); // Moved out, the body is not held between requests
+  }
+
+  HTTPUpload &upload = this->currentUpload;
+  upload.name = field;
+  upload.filename = filename;
+  upload.type = mime::getContentType(filename);
+  upload.totalSize = 0;
+  upload.currentSize = 0;
+  upload.status = UPLOAD_FILE_START;
+  if (route->uploadFn) route->uploadFn();
+
+  for (size_t offset = 0; offset < data.size(); offset += HTTP_UPLOAD_BUFLEN) {
+    upload.currentSize = std::min((size_t) HTTP_UPLOAD_BUFLEN, data.size() - offset);
+    memcpy(upload.buf, data.data() + offset, upload.currentSize);
+    upload.totalSize += upload.currentSize;
+    upload.status = UPLOAD_FILE_WRITE;
+    if (route->uploadFn) route->uploadFn();
+  }
+
+  upload.currentSize = 0;
+  upload.status = UPLOAD_FILE_END;
+  if (route->uploadFn) route->uploadFn();
+  route->fn();
+  return std::exchange(this->response, HostResponse()); // Moved out, the body is not held between requests
+}
+
+void ESP8266WebServer::writeResponse(WiFiClient &client) {
+  String head = "HTTP/1.1 " + String(this->response.code) + " " + statusText(this->response.code) + "\r\n";
+  head += "Content-Type: " + this->response.contentType + "\r\n";
+  if (this->response.chunked)
+    head += "Transfer-Encoding: chunked\r\n";
+  else
+    head += "Content-Length: " + String((unsigned long) this->response.body.size()) + "\r\n";
+  for (auto const &h : this->response.headers)
+    head += h.first + ": " + h.second + "\r\n";
+  head += "Connection: close\r\n\r\n";
+  client.write(head.c_str(), head.length());
+
+  if (this->response.chunked) {
+    char size[16];
+    snprintf(size, sizeof(size), "%zx\r\n", this->response.body.size());
+    if (!this->response.body.empty()) {
+      client.write(size, strlen(size));
+      client.write(this->response.body.data(), this->response.body.size());
+      client.write("\r\n", 2);
+    }
+    client.write("0\r\n\r\n", 5);
+  } else {
+    client.write(this->response.body.data(), this->response.body.size());
+  }
+}
+
+void ESP8266WebServer::handleClient() {
+  // Like the real server: one client at a time, whole request then whole response
+  WiFiClient client = this->server.accept();
+  if (!client)
+    return;
+
+  std::string raw;
+  while (client.available())
+    raw += (char) client.read();
+
+  size_t headerEnd = raw.find("\r\n\r\n");
+  if (headerEnd == std::string::npos) {
+    client.stop();
+    return;
+  }
+
+  std::vector<std::pair<String, String>> headers;
+  size_t lineEnd = raw.find("\r\n");
+  std::string requestLine = raw.substr(0, lineEnd);
+  size_t pos = lineEnd + 2;
+  while (pos < headerEnd) {
+    size_t end = raw.find("\r\n", pos);
+    std::string line = raw.substr(pos, end - pos);
+    size_t colon = line.find(':');
+    if (colon != std::string::npos) {
+      size_t value = line.find_first_not_of(' ', colon + 1);
+      headers.push_back({String(line.substr(0, colon)), String(value == std::string::npos ? std::string() : line.substr(value))});
+    }
+    pos = end + 2;
+  }
+
+  size_t sp1 = requestLine.find(' ');
+  size_t sp2 = requestLine.find(' ', sp1 + 1);
+  String method(requestLine.substr(0, sp1));
+  String uri(requestLine.substr(sp1 + 1, sp2 - sp1 - 1));
+
+  prepare(methodFromName(method), uri, String(raw.substr(headerEnd + 4)), headers);
+  this->currentClient = client;
+  dispatch();
+  this->currentClient = WiFiClient();
+  // Without a response the handler kept client(), the connection is its own (event streams)
+  if (!this->responseStarted && this->clientTaken)
+    return;
+  if (this->responseStarted)
+    writeResponse(client);
+  client.stop();
+}
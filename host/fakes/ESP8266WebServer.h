@@ -0,0 +1,158 @@
+#ifndef HOST_ESP8266WEBSERVER_H
+#define HOST_ESP8266WEBSERVER_H
+
+// Host replacement for ESP8266WebServer.
+// Requests can either be injected directly with hostRequest()/hostUpload(), which
+// returns the captured HostResponse, or arrive through WiFiServer in-memory
+// connections served one at a time from handleClient() like the real server.
+
+#include <functional>
+#include <utility>
+#include <vector>
+#include "Arduino.h"
+#include "FS.h"
+#include "umm_malloc/umm_malloc.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+enum HTTPUploadStatus { UPLOAD_FILE_START, UPLOAD_FILE_WRITE, UPLOAD_FILE_END, UPLOAD_FILE_ABORTED };
+
+#define HTTP_UPLOAD_BUFLEN 2048
+#define CONTENT_LENGTH_UNKNOWN ((size_t) -1)
+#define CONTENT_LENGTH_NOT_SET ((size_t) -2)
+
+typedef struct {
+  HTTPUploadStatus status;
+  String filename;
+  String name;
+  String type;
+  size_t totalSize;
+  size_t currentSize;
+  uint8_t buf[HTTP_UPLOAD_BUFLEN];
+} HTTPUpload;
+
+namespace mime {
+String getContentType(const String &filename);
+}
+
+typedef std::basic_string<char, std::char_traits<char>, HostUntrackedAllocator<char>> HostBody;
+
+struct HostResponse {
+  int code = 0;
+  String contentType;
+  std::vector<std::pair<String, String>> headers;
+  HostBody body;
+  bool chunked = false;
+  unsigned int chunks = 0; // sendContent() calls in chunked mode
+
+  String header(const String &name) const {
+    for (auto const &h : headers)
+      if (strcasecmp(h.first.c_str(), name.c_str()) == 0) return h.second;
+    return String();
+  }
+};
+
+class ESP8266WebServer {
+    public:
+        typedef std::function<void(void)> THandlerFunction;
+
+        ESP8266WebServer(int port = 80);
+        virtual ~ESP8266WebServer() {}
+
+        void begin();
+        void close();
+        void stop() { close(); }
+        void handleClient();
+
+        void on(const String &uri, HTTPMethod method, THandlerFunction fn);
+        void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction uploadFn);
+        void onNotFound(THandlerFunction fn) { this->notFoundHandler = fn; }
+
+        const String &uri() const { return this->currentUri; }
+        HTTPMethod method() const { return this->currentMethod; }
+        String arg(const String &name) const;
+        String arg(int i) const;
+        String argName(int i) const;
+        int args() const { return this->currentArgs.size(); }
+        bool hasArg(const String &name) const;
+        String header(const String &name) const;
+        bool hasHeader(const String &name) const;
+        void collectHeaders(const char *headerKeys[], const size_t headerKeysCount) { (void) headerKeys; (void) headerKeysCount; }
+
+        HTTPUpload &upload() { return this->currentUpload; }
+        WiFiClient &client() { this->clientTaken = true; return this->currentClient; }
+
+        void send(int code, const char *contentType = nullptr, const String &content = String(""));
+        void send(int code, const String &contentType, const String &content) { send(code, contentType.c_str(), content); }
+        void send(int code, const char *contentType, const char *content, size_t length) { send(code, contentType, String(content, length)); }
+        void send_P(int code, PGM_P contentType, PGM_P content) { send(code, contentType, String(content)); }
+        void sendHeader(const String &name, const String &value, bool first = false);
+        void setContentLength(const size_t contentLength) { this->contentLength = contentLength; }
+        void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+        void sendContent(const char *content, size_t size);
+        void sendContent_P(PGM_P content) { sendContent(content, strlen(content)); }
+        void sendContent_P(PGM_P content, size_t size) { sendContent(content, size); }
+        bool chunkedResponseModeStart(int code, const char *contentType);
+        bool chunkedResponseModeStart(int code, const String &contentType) { return chunkedResponseModeStart(code, contentType.c_str()); }
+        bool chunkedResponseModeStart_P(int code, PGM_P contentType) { return chunkedResponseModeStart(code, contentType); }
+        void chunkedResponseFinalize();
+
+        template <typename T>
+        size_t streamFile(T &file, const String &contentType, HTTPMethod requestMethod = HTTP_GET) {
+          String name(file.name());
+          if (name.endsWith(".gz") && contentType != "application/x-gzip" && contentType != "application/octet-stream")
+            sendHeader("Content-Encoding", "gzip");
+
+          HostBody body;
+          uint8_t buffer[512];
+          size_t n;
+          while ((n = file.read(buffer, sizeof(buffer))) > 0)
+            body.append((const char *) buffer, n);
+
+          send(200, contentType.c_str(), String());
+          if (requestMethod != HTTP_HEAD)
+            this->response.body = body;
+          return body.size();
+        }
+
+        static String urlDecode(const String &text);
+
+        // Host only: runs one request through the route table and returns the captured response
+        HostResponse hostRequest(HTTPMethod method, const String &uri, const String &body = String(),
+                             const std::vector<std::pair<String, String>> &headers = {});
+        // Host only: multipart upload of a single file field
+        HostResponse hostUpload(const String &uri, const String &field, const String &filename, const std::string &data);
+
+    private:
+        struct Route {
+          String uri;
+          HTTPMethod method;
+          THandlerFunction fn;
+          THandlerFunction uploadFn;
+        };
+
+        WiFiServer server;
+        std::vector<Route> routes;
+        THandlerFunction notFoundHandler;
+
+        String currentUri;
+        HTTPMethod currentMethod = HTTP_GET;
+        std::vector<std::pair<String, String>> currentArgs;
+        std::vector<std::pair<String, String>> currentHeaders;
+        HTTPUpload currentUpload;
+        WiFiClient currentClient;
+        bool clientTaken = false; // client() was called during the request
+
+        std::vector<std::pair<String, String>> pendingHeaders;
+        size_t contentLength = CONTENT_LENGTH_NOT_SET;
+        HostResponse response;
+        bool responseStarted = false;
+
+        void prepare(HTTPMethod method, const String &uri, const String &body, const std::vector<std::pair<String, String>> &headers);
+        Route *findRoute();
+        void dispatch();
+        void writeResponse(WiFiClient &client);
+};
+
+#endif
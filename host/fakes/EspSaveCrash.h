@@ -0,0 +1,15 @@
+#ifndef HOST_ESPSAVECRASH_H
+#define HOST_ESPSAVECRASH_H
+
+#include "Arduino.h"
+
+class EspSaveCrash {
+    public:
+        EspSaveCrash(uint16_t offset = 0x0010, uint16_t size = 0x0200) { (void) offset; (void) size; }
+        void crashToBuffer(char *buffer) { strcpy(buffer, "No crashes saved\n"); }
+        void clear() {}
+        void print(Print &out = Serial) { out.println("No crashes saved"); }
+        int count() { return 0; }
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "FS.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include "LittleFS.h"
+#include "flash_hal.h"
+
+namespace stdfs = std::filesystem;
+
+fs::FS LittleFS;
+unsigned long fs::File::bytesWritten = 0;
+
+namespace fs {
+
+static std::string baseName(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+File::File(const std::string &hostPath, const String &name, const char *mode) {
+  std::error_code ec;
+  this->impl = std::make_shared<Impl>();
+  this->impl->hostPath = hostPath;
+  this->impl->fullName = name.c_str();
+  this->impl->name = baseName(name.c_str());
+
+  if (stdfs::is_directory(hostPath, ec)) {
+    this->impl->directory = true;
+    return;
+  }
+
+  std::string m(mode);
+  if (m != "r")
+    stdfs::create_directories(stdfs::path(hostPath).parent_path(), ec);
+
+  std::string cmode = m + "b";
+  this->impl->fp = fopen(hostPath.c_str(), cmode.c_str());
+  if (!this->impl->fp)
+    this->impl.reset();
+}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  if (!this->impl || !this->impl->fp)
+    return 0;
+  size_t n = fwrite(buffer, 1, size, this->impl->fp);
+  bytesWritten += n;
+  return n;
+}
+
+int File::available() {
+  if (!this->impl || !this->impl->fp)
+    return 0;
+  return (int) (size() - position());
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  if (!this->impl || !this->impl->fp)
+    return -1;
+  int c = fgetc(this->impl->fp);
+  if (c != EOF)
+    ungetc(c, this->impl->fp);
+  return c == EOF ? -1 : c;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+  if (!this->impl || !this->impl->fp)
+    return 0;
+  fflush(this->impl->fp);
+  return fread(buffer, 1, size, this->impl->fp);
+}
+
+void File::flush() {
+  if (this->impl && this->impl->fp)
+    fflush(this->impl->fp);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!this->impl || !this->impl->fp)
+    return false;
+  int whence = mode == SeekSet ? SEEK_SET : (mode == SeekCur ? SEEK_CUR : SEEK_END);
+  return fseek(this->impl->fp, pos, whence) == 0;
+}
+
+size_t File::position() const {
+  if (!this->impl || !this->impl->fp)
+    return 0;
+  long pos = ftell(this->impl->fp);
+  return pos < 0 ? 0 : pos;
+}
+
+size_t File::size() const {
+  if (!this->impl || !this->impl->fp)
+    return 0;
+  fflush(this->impl->fp);
+  struct stat st;
+  return fstat(fileno(this->impl->fp), &st) == 0 ? st.st_size : 0;
+}
+
+bool File::truncate(uint32_t size) {
+  if (!this->impl || !this->impl->fp)
+    return false;
+  fflush(this->impl->fp);
+  return ftruncate(fileno(this->impl->fp), size) == 0;
+}
+
+void File::close() {
+  this->impl.reset();
+}
+
+const char *File::name() const {
+  return this->impl ? this->impl->name.c_str() : "";
+}
+
+const char *File::fullName() const {
+  return this->impl ? this->impl->fullName.c_str() : "";
+}
+
+bool File::isFile() const {
+  return this->impl && this->impl->fp;
+}
+
+bool File::isDirectory() const {
+  return this->impl && this->impl->directory;
+}
+
+time_t File::getLastWrite() {
+  if (!this->impl)
+    return 0;
+  flush();
+  struct stat st;
+  return stat(this->impl->hostPath.c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+Dir::Dir(const std::string &hostPath, const String &path) : hostPath(hostPath), path(path) {
+  std::error_code ec;
+  for (auto const &entry : stdfs::directory_iterator(hostPath, ec)) {
+    Entry e;
+    e.name = entry.path().filename().string();
+    e.directory = entry.is_directory(ec);
+    e.size = e.directory ? 0 : entry.file_size(ec);
+    struct stat st;
+    e.mtime = stat(entry.path().c_str(), &st) == 0 ? st.st_mtime : 0;
+    this->entries.push_back(e);
+  }
+  std::sort(this->entries.begin(), this->entries.end(), [](const Entry &a, const Entry &b) { return a.name < b.name; });
+}
+
+bool Dir::next() {
+  if (this->index + 1 >= (int) this->entries.size())
+    return false;
+  this->index++;
+  return true;
+}
+
+String Dir::fileName() const {
+  return this->index >= 0 ? String(this->entries[this->index].name) : String();
+}
+
+size_t Dir::fileSize() const {
+  return this->index >= 0 ? this->entries[this->index].size : 0;
+}
+
+time_t Dir::fileTime() const {
+  return this->index >= 0 ? this->entries[this->index].mtime : 0;
+}
+
+bool Dir::isFile() const {
+  return this->index >= 0 && !this->entries[this->index].directory;
+}
+
+bool Dir::isDirectory() const {
+  return this->index >= 0 && this->entries[this->index].directory;
+}
+
+File Dir::openFile(const char *mode) {
+  if (this->index < 0)
+    return File();
+  String name = this->path;
+  if (!name.endsWith("/"))
+    name += '/';
+  name += this->entries[this->index].name.c_str();
+  return File(this->hostPath + "/" + this->entries[this->index].name, name, mode);
+}
+
+std::string FS::hostPath(const char *path) {
+  std::string p(path ? path : "");
+  if (p.empty() || p[0] != '/')
+    p = "/" + p;
+  return this->root + p;
+}
+
+bool FS::format() {
+  std::error_code ec;
+  stdfs::remove_all(this->root, ec);
+  return stdfs::create_directories(this->root, ec);
+}
+
+bool FS::info(FSInfo &info) {
+  std::error_code ec;
+  size_t used = 0;
+  for (auto const &entry : stdfs::recursive_directory_iterator(this->root, ec))
+    if (entry.is_regular_file(ec))
+      used += entry.file_size(ec);
+
+  info.totalBytes = _FS_end - _FS_start;
+  info.usedBytes = used;
+  info.blockSize = 8192;
+  info.pageSize = 256;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  return true;
+}
+
+bool FS::exists(const char *path) {
+  std::error_code ec;
+  return stdfs::exists(hostPath(path), ec);
+}
+
+File FS::open(const char *path, const char *mode) {
+  std::string p(path ? path : "");
+  if (p.empty() || p[0] != '/')
+    p = "/" + p;
+  if (std::string(mode) == "r" && !exists(p.c_str()))
+    return File();
+  return File(hostPath(p.c_str()), String(p), mode);
+}
+
+Dir FS::openDir(const char *path) {
+  return Dir(hostPath(path), String(path));
+}
+
+bool FS::remove(const char *path) {
+  std::error_code ec;
+  return stdfs::is_regular_file(hostPath(path), ec) && stdfs::remove(hostPath(path), ec);
+}
+
+bool FS::rename(const char *from, const char *to) {
+  std::error_code ec;
+  stdfs::create_directories(stdfs::path(hostPath(to)).parent_path(), ec);
+  stdfs::rename(hostPath(from), hostPath(to), ec);
+  return !ec;
+}
+
+bool FS::mkdir(const char *path) {
+  std::error_code ec;
+  stdfs::create_directories(hostPath(path), ec);
+  return !ec;
+}
+
+bool FS::rmdir(const char *path) {
+  std::error_code ec;
+  return stdfs::remove(hostPath(path), ec);
+}
+
+} // namespace fs
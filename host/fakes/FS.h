@@ -0,0 +1,137 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+// LittleFS replacement storing files in a host directory
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Arduino.h"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FSInfo {
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+class File : public Stream {
+    public:
+        File() {}
+        File(const std::string &hostPath, const String &name, const char *mode);
+
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *buffer, size_t size) override;
+        using Print::write;
+        int available() override;
+        int read() override;
+        int peek() override;
+        size_t read(uint8_t *buffer, size_t size);
+        size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *) buffer, length); }
+        void flush() override;
+
+        bool seek(uint32_t pos, SeekMode mode = SeekSet);
+        size_t position() const;
+        size_t size() const;
+        bool truncate(uint32_t size);
+        void close();
+
+        const char *name() const;
+        const char *fullName() const;
+        bool isFile() const;
+        bool isDirectory() const;
+        time_t getLastWrite();
+        time_t getCreationTime() { return getLastWrite(); }
+
+        operator bool() const { return this->impl && (this->impl->fp || this->impl->directory); }
+
+        static unsigned long bytesWritten; // Host only: total bytes written through File
+
+    private:
+        struct Impl {
+          FILE *fp = nullptr;
+          bool directory = false;
+          std::string hostPath;
+          std::string fullName;
+          std::string name;
+          ~Impl() { if (fp) fclose(fp); }
+        };
+        std::shared_ptr<Impl> impl;
+};
+
+class Dir {
+    public:
+        Dir() {}
+        Dir(const std::string &hostPath, const String &path);
+
+        bool next();
+        String fileName() const;
+        size_t fileSize() const;
+        time_t fileTime() const;
+        bool isFile() const;
+        bool isDirectory() const;
+        File openFile(const char *mode);
+        bool rewind() { this->index = -1; return true; }
+
+    private:
+        struct Entry {
+          std::string name;
+          bool directory;
+          size_t size;
+          time_t mtime;
+        };
+        std::string hostPath;
+        String path;
+        std::vector<Entry> entries;
+        int index = -1;
+};
+
+class FS {
+    public:
+        bool begin() { return true; }
+        void end() {}
+        bool format();
+        bool info(FSInfo &info);
+
+        bool exists(const char *path);
+        bool exists(const String &path) { return exists(path.c_str()); }
+        File open(const char *path, const char *mode);
+        File open(const String &path, const char *mode) { return open(path.c_str(), mode); }
+        Dir openDir(const char *path);
+        Dir openDir(const String &path) { return openDir(path.c_str()); }
+        bool remove(const char *path);
+        bool remove(const String &path) { return remove(path.c_str()); }
+        bool rename(const char *from, const char *to);
+        bool rename(const String &from, const String &to) { return rename(from.c_str(), to.c_str()); }
+        bool mkdir(const char *path);
+        bool mkdir(const String &path) { return mkdir(path.c_str()); }
+        bool rmdir(const char *path);
+        bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+        // Host only: directory used as the filesystem root
+        void setRoot(const std::string &root) { this->root = root; }
+        const std::string &getRoot() { return this->root; }
+
+    private:
+        std::string root = "data";
+        std::string hostPath(const char *path);
+};
+
+} // namespace fs
+
+using fs::Dir;
+using fs::FS;
+using fs::FSInfo;
+using fs::File;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
+
+#endif
@@ -0,0 +1,99 @@
+#include "umm_malloc/umm_malloc.h"
+#include <malloc.h>
+
+// glibc entry points, the wrappers below replace malloc for the whole process
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+}
+
+static size_t mallocCount = 0;
+static size_t reallocCount = 0;
+static size_t freeCount = 0;
+static size_t liveBytes = 0;
+static size_t baseline = 0;
+static bool tracking = false;
+static uint32_t minFree = HOST_HEAP_BYTES;
+
+uint32_t hostHeapFree() {
+  if (!tracking || liveBytes <= baseline)
+    return HOST_HEAP_BYTES;
+  size_t used = liveBytes - baseline;
+  return used >= HOST_HEAP_BYTES ? 0 : (uint32_t) (HOST_HEAP_BYTES - used);
+}
+
+static void charge(void *ptr) {
+  liveBytes += malloc_usable_size(ptr);
+  uint32_t free = hostHeapFree();
+  if (free < minFree)
+    minFree = free;
+}
+
+static void release(void *ptr) {
+  size_t size = malloc_usable_size(ptr);
+  liveBytes = size > liveBytes ? 0 : liveBytes - size;
+}
+
+extern "C" void *malloc(size_t size) {
+  void *ptr = __libc_malloc(size);
+  if (ptr) {
+    mallocCount++;
+    charge(ptr);
+  }
+  return ptr;
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  void *ptr = __libc_calloc(count, size);
+  if (ptr) {
+    mallocCount++;
+    charge(ptr);
+  }
+  return ptr;
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  if (ptr)
+    release(ptr);
+  void *result = __libc_realloc(ptr, size);
+  reallocCount++;
+  if (result)
+    charge(result);
+  else if (ptr && size)
+    charge(ptr); // Failed, the old block is still there
+  return result;
+}
+
+extern "C" void free(void *ptr) {
+  if (!ptr)
+    return;
+  freeCount++;
+  release(ptr);
+  __libc_free(ptr);
+}
+
+size_t umm_get_malloc_count() { return mallocCount; }
+size_t umm_get_realloc_count() { return reallocCount; }
+size_t umm_get_free_count() { return freeCount; }
+size_t umm_free_heap_size_min() { return minFree; }
+
+size_t umm_free_heap_size_min_reset() {
+  minFree = hostHeapFree();
+  return minFree;
+}
+
+void *hostUntrackedAlloc(size_t size) {
+  return __libc_malloc(size);
+}
+
+void hostUntrackedFree(void *ptr) {
+  __libc_free(ptr);
+}
+
+void hostHeapReset() {
+  baseline = liveBytes;
+  tracking = true;
+  minFree = HOST_HEAP_BYTES;
+}
@@ -0,0 +1,58 @@
+#ifndef HOST_HARDWARE_H
+#define HOST_HARDWARE_H
+
+// Hardware abstraction for the host build.
+// Every fake (GPIO, ADC, sensors, clock) reads and writes this single state
+// so a simulation can drive the sketch and observe its outputs.
+
+#include <stdint.h>
+#include <time.h>
+
+#define HOST_GPIO_COUNT 32
+
+struct HostHardware {
+  // Simulated clock. epoch is the wall clock, the ms/us counters are the
+  // time since boot as returned by millis()/micros().
+  static time_t epoch;
+  static uint64_t uptimeUs;
+
+  // GPIO
+  static uint8_t pinModes[HOST_GPIO_COUNT];
+  static uint8_t pinLevel[HOST_GPIO_COUNT];
+  static unsigned long pinWrites[HOST_GPIO_COUNT];
+
+  // ADC (A0) raw value 0..1023, optional noise amplitude in counts
+  static int adcValue;
+  static int adcNoise;
+  static unsigned long adcReads;
+
+  // DS18B20
+  static float waterTemperature;
+  static unsigned long dallasRequests;
+
+  // Pool reader (pH, ORP, water level, ambient temperature)
+  static float ambientTemperature;
+  static float ph;
+  static uint16_t phRaw;
+  static float orp;
+  static uint16_t orpRaw;
+  static float waterLevel;
+  static bool poolReaderFails;
+  static unsigned long poolReaderReadUs;
+  static unsigned long poolReaderReads;
+
+  // Called after each advance of the clock, e.g. to let simulated network peers read
+  static void (*onAdvance)(uint64_t us);
+
+  static void advanceMs(unsigned long ms) { advanceUs((uint64_t) ms * 1000); }
+
+  static void advanceUs(uint64_t us) {
+    uint64_t before = uptimeUs / 1000000;
+    uptimeUs += us;
+    epoch += (time_t) (uptimeUs / 1000000 - before);
+    if (onAdvance)
+      onAdvance(us);
+  }
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef HOST_ONEWIRE_H
+#define HOST_ONEWIRE_H
+
+#include "Arduino.h"
+
+class OneWire {
+    public:
+        OneWire(uint8_t pin) : pin(pin) {}
+        uint8_t reset() { return 1; }
+
+    private:
+        uint8_t pin;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef HOST_POOLREADERCLIENT_H
+#define HOST_POOLREADERCLIENT_H
+
+#include "Arduino.h"
+#include "OneWire.h"
+
+// Pool reader 1-Wire slave returning the HostHardware pool values
+class PoolReaderClient {
+    public:
+        PoolReaderClient(OneWire *wire) { (void) wire; }
+
+        bool read() {
+          HostHardware::poolReaderReads++;
+          HostHardware::advanceUs(HostHardware::poolReaderReadUs); // Blocking bus transaction
+          if (HostHardware::poolReaderFails)
+            return false;
+
+          this->temperature = HostHardware::ambientTemperature;
+          this->ph = HostHardware::ph;
+          this->phRaw = HostHardware::phRaw;
+          this->orp = HostHardware::orp;
+          this->orpRaw = HostHardware::orpRaw;
+          this->waterLevel = HostHardware::waterLevel;
+          return true;
+        }
+
+        void setCalibrationValue(float temperature, float buffer, uint16_t adcValue) {
+          this->calTemperature = temperature;
+          this->calBuffer = buffer;
+          this->calAdc = adcValue;
+        }
+
+        float getTemperature() { return this->temperature; }
+        float getPh() { return this->ph; }
+        uint16_t getPhRaw() { return this->phRaw; }
+        float getOrp() { return this->orp; }
+        uint16_t getOrpRaw() { return this->orpRaw; }
+        float getWaterLevel() { return this->waterLevel; }
+        unsigned long getSampleInterval() { return 1000; }
+
+    private:
+        float temperature = 0;
+        float ph = 0;
+        uint16_t phRaw = 0;
+        float orp = 0;
+        uint16_t orpRaw = 0;
+        float waterLevel = 0;
+        float calTemperature = 0;
+        float calBuffer = 0;
+        uint16_t calAdc = 0;
+};
+
+#endif
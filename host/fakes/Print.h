@@ -0,0 +1,104 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "WString.h"
+
+#define DEC 10
+#define HEX 16
+
+class Print {
+    public:
+        virtual ~Print() {}
+
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size) {
+          size_t n = 0;
+          while (size--) {
+            if (!write(*buffer++)) break;
+            n++;
+          }
+          return n;
+        }
+        size_t write(const char *str) { return str ? write((const uint8_t *) str, strlen(str)) : 0; }
+        size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+        virtual int availableForWrite() { return 0; }
+        virtual void flush() {}
+
+        size_t print(const __FlashStringHelper *str) { return write(reinterpret_cast<const char *>(str)); }
+        size_t print(const String &str) { return write(str.c_str(), str.length()); }
+        size_t print(const char *str) { return write(str); }
+        size_t print(char c) { return write((uint8_t) c); }
+        size_t print(unsigned char v, int base = DEC) { return print(String(v, base)); }
+        size_t print(int v, int base = DEC) { return print(String(v, base)); }
+        size_t print(unsigned int v, int base = DEC) { return print(String(v, base)); }
+        size_t print(long v, int base = DEC) { return print(String(v, base)); }
+        size_t print(unsigned long v, int base = DEC) { return print(String(v, base)); }
+        size_t print(long long v, int base = DEC) { return print(String(v, base)); }
+        size_t print(unsigned long long v, int base = DEC) { return print(String(v, base)); }
+        size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+
+        size_t println() { return write("\r\n"); }
+        template <typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+        template <typename T> size_t println(const T &v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+
+        size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+          char buf[256];
+          va_list args;
+          va_start(args, format);
+          int len = vsnprintf(buf, sizeof(buf), format, args);
+          va_end(args);
+          if (len < 0) return 0;
+          if ((size_t) len < sizeof(buf)) return write(buf, len);
+
+          std::string big(len + 1, '\0');
+          va_start(args, format);
+          vsnprintf(&big[0], big.size(), format, args);
+          va_end(args);
+          return write(big.c_str(), len);
+        }
+        size_t printf_P(const char *format, ...) {
+          char buf[256];
+          va_list args;
+          va_start(args, format);
+          int len = vsnprintf(buf, sizeof(buf), format, args);
+          va_end(args);
+          return len > 0 ? write(buf, len < (int) sizeof(buf) ? len : sizeof(buf) - 1) : 0;
+        }
+};
+
+class Stream : public Print {
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() = 0;
+
+        void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+
+        virtual size_t readBytes(char *buffer, size_t length) {
+          size_t count = 0;
+          while (count < length) {
+            int c = read();
+            if (c < 0) break;
+            *buffer++ = (char) c;
+            count++;
+          }
+          return count;
+        }
+        size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *) buffer, length); }
+
+        String readString() {
+          String ret;
+          int c;
+          while ((c = read()) >= 0) ret += (char) c;
+          return ret;
+        }
+
+    protected:
+        unsigned long timeout = 1000;
+};
+
+#endif
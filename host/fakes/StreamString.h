@@ -0,0 +1,18 @@
+#ifndef HOST_STREAMSTRING_H
+#define HOST_STREAMSTRING_H
+
+#include "Arduino.h"
+
+class StreamString : public String, public Stream {
+    public:
+        size_t write(uint8_t c) override { concat((char) c); return 1; }
+        size_t write(const uint8_t *buffer, size_t size) override { concat((const char *) buffer, size); return size; }
+        int available() override { return length() - readPos; }
+        int read() override { return readPos < length() ? (uint8_t) (*this)[readPos++] : -1; }
+        int peek() override { return readPos < length() ? (uint8_t) (*this)[readPos] : -1; }
+
+    private:
+        unsigned int readPos = 0;
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HOST_UPDATER_H
+#define HOST_UPDATER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define U_FLASH 0
+#define U_FS 100
+
+class Print;
+
+// Accepts and discards firmware images
+class UpdaterClass {
+    public:
+        bool begin(size_t size, int command = U_FLASH) { (void) command; this->size = size; this->written = 0; this->error = false; return true; }
+        size_t write(uint8_t *data, size_t len) { (void) data; this->written += len; return len; }
+        bool end(bool evenIfRemaining = false) { (void) evenIfRemaining; return !this->error; }
+        bool hasError() { return this->error; }
+        void printError(Print &out);
+
+    private:
+        size_t size = 0;
+        size_t written = 0;
+        bool error = false;
+};
+
+extern UpdaterClass Update;
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+// Host replacement for the Arduino String class, backed by std::string.
+// Only the subset used by the sketch is provided.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+class __FlashStringHelper;
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper *>(pstr_pointer))
+#define F(string_literal) (FPSTR(string_literal))
+
+class String {
+    public:
+        String() {}
+        String(const char *cstr) : s(cstr ? cstr : "") {}
+        String(const char *cstr, size_t length) : s(cstr, length) {}
+        String(const std::string &str) : s(str) {}
+        String(const __FlashStringHelper *str) : s(reinterpret_cast<const char *>(str)) {}
+        explicit String(char c) : s(1, c) {}
+        explicit String(unsigned char v, unsigned char base = 10) { fromUnsigned(v, base); }
+        explicit String(int v, unsigned char base = 10) { fromSigned(v, base); }
+        explicit String(unsigned int v, unsigned char base = 10) { fromUnsigned(v, base); }
+        explicit String(long v, unsigned char base = 10) { fromSigned(v, base); }
+        explicit String(unsigned long v, unsigned char base = 10) { fromUnsigned(v, base); }
+        explicit String(long long v, unsigned char base = 10) { fromSigned(v, base); }
+        explicit String(unsigned long long v, unsigned char base = 10) { fromUnsigned(v, base); }
+        explicit String(float v, unsigned char decimals = 2) { fromDouble(v, decimals); }
+        explicit String(double v, unsigned char decimals = 2) { fromDouble(v, decimals); }
+
+        const char *c_str() const { return s.c_str(); }
+        unsigned int length() const { return s.length(); }
+        bool isEmpty() const { return s.empty(); }
+        void clear() { s.clear(); }
+        bool reserve(unsigned int size) { s.reserve(size); return true; }
+
+        char operator[](unsigned int index) const { return index < s.size() ? s[index] : 0; }
+        char &operator[](unsigned int index) { return s[index]; }
+        char charAt(unsigned int index) const { return (*this)[index]; }
+
+        String &operator=(const char *cstr) { s = cstr ? cstr : ""; return *this; }
+        String &operator=(const __FlashStringHelper *str) { s = reinterpret_cast<const char *>(str); return *this; }
+        String &operator=(char c) { s.assign(1, c); return *this; }
+
+        String &operator+=(const String &rhs) { s += rhs.s; return *this; }
+        String &operator+=(const char *cstr) { if (cstr) s += cstr; return *this; }
+        String &operator+=(const __FlashStringHelper *str) { s += reinterpret_cast<const char *>(str); return *this; }
+        String &operator+=(char c) { s += c; return *this; }
+        String &operator+=(unsigned char v) { return *this += String(v); }
+        String &operator+=(int v) { return *this += String(v); }
+        String &operator+=(unsigned int v) { return *this += String(v); }
+        String &operator+=(long v) { return *this += String(v); }
+        String &operator+=(unsigned long v) { return *this += String(v); }
+        String &operator+=(long long v) { return *this += String(v); }
+        String &operator+=(unsigned long long v) { return *this += String(v); }
+        String &operator+=(float v) { return *this += String(v); }
+        String &operator+=(double v) { return *this += String(v); }
+
+        bool concat(const String &rhs) { s += rhs.s; return true; }
+        bool concat(const char *cstr, unsigned int length) { s.append(cstr, length); return true; }
+        bool concat(char c) { s += c; return true; }
+
+        bool operator==(const String &rhs) const { return s == rhs.s; }
+        bool operator==(const char *cstr) const { return s == (cstr ? cstr : ""); }
+        bool operator!=(const String &rhs) const { return s != rhs.s; }
+        bool operator!=(const char *cstr) const { return !(*this == cstr); }
+        bool operator<(const String &rhs) const { return s < rhs.s; }
+        bool equals(const String &rhs) const { return s == rhs.s; }
+        bool equals(const char *cstr) const { return *this == cstr; }
+        bool equalsIgnoreCase(const String &rhs) const { return s.size() == rhs.s.size() && strncasecmp(s.c_str(), rhs.s.c_str(), s.size()) == 0; }
+
+        bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.size(), prefix.s) == 0; }
+        bool endsWith(const String &suffix) const {
+          return s.size() >= suffix.s.size() && s.compare(s.size() - suffix.s.size(), suffix.s.size(), suffix.s) == 0;
+        }
+
+        int indexOf(char c, unsigned int from = 0) const { return toIndex(s.find(c, from)); }
+        int indexOf(const String &str, unsigned int from = 0) const { return toIndex(s.find(str.s, from)); }
+        int lastIndexOf(char c) const { return toIndex(s.rfind(c)); }
+        int lastIndexOf(const String &str) const { return toIndex(s.rfind(str.s)); }
+
+        String substring(unsigned int from) const { return from < s.size() ? String(s.substr(from)) : String(); }
+        String substring(unsigned int from, unsigned int to) const {
+          if (from > to) { unsigned int t = from; from = to; to = t; }
+          if (from >= s.size()) return String();
+          return String(s.substr(from, to - from));
+        }
+
+        void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+        void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+        void replace(const String &find, const String &with) {
+          if (find.s.empty()) return;
+          size_t pos = 0;
+          while ((pos = s.find(find.s, pos)) != std::string::npos) {
+            s.replace(pos, find.s.size(), with.s);
+            pos += with.s.size();
+          }
+        }
+        void trim() {
+          size_t b = s.find_first_not_of(" \t\r\n");
+          size_t e = s.find_last_not_of(" \t\r\n");
+          s = (b == std::string::npos) ? std::string() : s.substr(b, e - b + 1);
+        }
+        void toLowerCase() { for (auto &c : s) c = tolower(c); }
+
+        long toInt() const { return atol(s.c_str()); }
+        float toFloat() const { return atof(s.c_str()); }
+
+        const std::string &std() const { return s; }
+
+    private:
+        std::string s;
+
+        static int toIndex(size_t pos) { return pos == std::string::npos ? -1 : (int) pos; }
+
+        void fromSigned(long long v, unsigned char base) {
+          if (v < 0 && base == 10) { s = "-"; fromUnsignedAppend((unsigned long long) -v, base); }
+          else fromUnsigned((unsigned long long) v, base);
+        }
+        void fromUnsigned(unsigned long long v, unsigned char base) { s.clear(); fromUnsignedAppend(v, base); }
+        void fromUnsignedAppend(unsigned long long v, unsigned char base) {
+          char buf[72];
+          int i = sizeof(buf) - 1;
+          buf[i] = 0;
+          do {
+            unsigned int d = v % base;
+            buf[--i] = d < 10 ? '0' + d : 'A' + d - 10;
+            v /= base;
+          } while (v && i > 0);
+          s += &buf[i];
+        }
+        void fromDouble(double v, unsigned char decimals) {
+          char buf[48];
+          snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+          s = buf;
+        }
+};
+
+inline String operator+(const String &lhs, const String &rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, const char *rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const char *lhs, const String &rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, char rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, int rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, unsigned int rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, long rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, unsigned long rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, float rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, double rhs) { String r(lhs); r += rhs; return r; }
+inline String operator+(const String &lhs, const __FlashStringHelper *rhs) { String r(lhs); r += rhs; return r; }
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+// In-memory TCP connection. The server side is a WiFiClient, the peer side is
+// driven by the simulation through the same HostConnection. A WiFiClient
+// opened with connect() is the peer side of a connection to a WiFiServer of
+// the simulation, it reads toClient and writes toServer.
+
+#include <deque>
+#include <memory>
+#include "Arduino.h"
+#include "HostHardware.h"
+
+struct HostConnection {
+  std::deque<uint8_t> toServer;   // bytes sent by the peer, read by the sketch
+  std::deque<uint8_t> toClient;   // bytes written by the sketch, read by the peer
+  size_t sendWindow = 2920;       // free room the sketch sees in availableForWrite()
+  bool serverClosed = false;
+  bool peerClosed = false;
+  unsigned long bytesSent = 0;
+
+  // With a rate the peer reads by itself as simulated time passes, into received,
+  // and a write larger than the window blocks (advancing the clock) like lwIP does.
+  // Without one the simulation reads with peerRead() and writes never block.
+  size_t peerBytesPerMs = 0;
+  uint64_t peerCredit = 0; // Bytes allowed so far, x1000
+  std::string received;
+
+  void peerDrain(uint64_t us) {
+    if (toClient.empty()) {
+      peerCredit = 0;
+      return;
+    }
+    peerCredit += (uint64_t) peerBytesPerMs * us;
+    while (peerCredit >= 1000 && !toClient.empty()) {
+      received += (char) toClient.front();
+      toClient.pop_front();
+      peerCredit -= 1000;
+    }
+  }
+
+  // Peer helpers
+  void peerWrite(const std::string &data) { toServer.insert(toServer.end(), data.begin(), data.end()); }
+  std::string peerRead(size_t max = (size_t) -1) {
+    std::string out;
+    while (!toClient.empty() && out.size() < max) {
+      out += (char) toClient.front();
+      toClient.pop_front();
+    }
+    return out;
+  }
+};
+
+class WiFiClient : public Stream {
+    public:
+        WiFiClient() {}
+        WiFiClient(std::shared_ptr<HostConnection> connection) : connection(connection) {}
+
+        // To a WiFiServer of the simulation on port, the host is ignored. 0 when nobody listens
+        int connect(const char *host, uint16_t port);
+
+        uint8_t connected() {
+          if (!this->connection) return 0;
+          if (this->outgoing)
+            return !this->connection->peerClosed && (!this->connection->serverClosed || !this->connection->toClient.empty());
+          return !this->connection->serverClosed && (!this->connection->peerClosed || !this->connection->toServer.empty());
+        }
+        operator bool() { return connected(); }
+        int available() override { return this->connection ? incoming().size() : 0; }
+        int read() override {
+          if (!available()) return -1;
+          uint8_t c = incoming().front();
+          incoming().pop_front();
+          return c;
+        }
+        int read(uint8_t *buffer, size_t size) {
+          size_t n = 0;
+          while (n < size && available()) buffer[n++] = (uint8_t) read();
+          return n;
+        }
+        int peek() override { return available() ? incoming().front() : -1; }
+
+        int availableForWrite() override {
+          if (!connected()) return 0;
+          if (this->outgoing) return this->connection->sendWindow;
+          size_t used = this->connection->toClient.size();
+          return used >= this->connection->sendWindow ? 0 : this->connection->sendWindow - used;
+        }
+        size_t write(uint8_t c) override { return write(&c, 1); }
+        size_t write(const uint8_t *buffer, size_t size) override {
+          if (!connected()) return 0;
+          if (this->outgoing) {
+            this->connection->toServer.insert(this->connection->toServer.end(), buffer, buffer + size);
+            return size;
+          }
+          size_t done = 0;
+          while (done < size && connected()) {
+            size_t n = size - done;
+            if (this->connection->peerBytesPerMs) {
+              n = std::min(n, (size_t) availableForWrite());
+              if (n == 0) {
+                HostHardware::advanceMs(1); // Waiting for ACKs
+                continue;
+              }
+            }
+            this->connection->toClient.insert(this->connection->toClient.end(), buffer + done, buffer + done + n);
+            this->connection->bytesSent += n;
+            done += n;
+          }
+          return done;
+        }
+        using Print::write;
+
+        void stop() {
+          if (this->connection && this->outgoing)
+            this->connection->peerClosed = true;
+          else if (this->connection)
+            this->connection->serverClosed = true;
+        }
+        // Nothing to wait for here, sent bytes are already delivered
+        bool stop(unsigned int maxWaitMs) {
+          (void) maxWaitMs;
+          stop();
+          return true;
+        }
+        void abort() { stop(); }
+        void setNoDelay(bool noDelay) { (void) noDelay; }
+        void keepAlive(uint16_t idle = 0, uint16_t interval = 0, uint8_t count = 0) { (void) idle; (void) interval; (void) count; }
+
+        std::shared_ptr<HostConnection> hostConnection() { return this->connection; }
+
+    private:
+        std::shared_ptr<HostConnection> connection;
+        bool outgoing = false; // Opened by connect()
+
+        std::deque<uint8_t> &incoming() { return this->outgoing ? this->connection->toClient : this->connection->toServer; }
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef HOST_WIFISERVER_H
+#define HOST_WIFISERVER_H
+
+#include <deque>
+#include <map>
+#include <vector>
+#include "WiFiClient.h"
+
+// Listening socket fed by HostNetwork::connect()
+class WiFiServer {
+    public:
+        WiFiServer(uint16_t port) : port(port) {}
+        void begin();
+        void close();
+        void stop() { close(); }
+        void setNoDelay(bool noDelay) { (void) noDelay; }
+        WiFiClient accept();
+        WiFiClient available() { return accept(); }
+        bool hasClient();
+
+    private:
+        uint16_t port;
+};
+
+struct HostNetwork {
+  static std::map<uint16_t, std::deque<std::shared_ptr<HostConnection>>> pending;
+  static std::map<uint16_t, bool> listening;
+  static std::vector<std::weak_ptr<HostConnection>> open; // Drained as the clock advances
+
+  // Opens a connection to a listening WiFiServer, nullptr when nobody listens.
+  // peerBytesPerMs > 0 makes the peer read at that rate, see HostConnection.
+  static std::shared_ptr<HostConnection> connect(uint16_t port, size_t peerBytesPerMs = 0) {
+    if (!listening[port]) return nullptr;
+    std::shared_ptr<HostConnection> connection = std::make_shared<HostConnection>();
+    connection->peerBytesPerMs = peerBytesPerMs;
+    pending[port].push_back(connection);
+    if (peerBytesPerMs) {
+      open.push_back(connection);
+      HostHardware::onAdvance = &HostNetwork::drain;
+    }
+    return connection;
+  }
+
+  static void drain(uint64_t us) {
+    for (size_t i = 0; i < open.size();) {
+      std::shared_ptr<HostConnection> connection = open[i].lock();
+      if (!connection) {
+        open.erase(open.begin() + i);
+        continue;
+      }
+      connection->peerDrain(us);
+      i++;
+    }
+  }
+};
+
+#endif
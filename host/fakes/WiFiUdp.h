@@ -0,0 +1,9 @@
+#ifndef HOST_WIFIUDP_H
+#define HOST_WIFIUDP_H
+
+class WiFiUDP {
+    public:
+        static void stopAll() {}
+};
+
+#endif
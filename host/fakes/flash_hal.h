@@ -0,0 +1,11 @@
+#ifndef HOST_FLASH_HAL_H
+#define HOST_FLASH_HAL_H
+
+#include <stdint.h>
+
+extern "C" uint32_t _FS_start;
+extern "C" uint32_t _FS_end;
+
+void close_all_fs();
+
+#endif
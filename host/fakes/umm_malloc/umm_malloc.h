@@ -0,0 +1,39 @@
+#ifndef HOST_UMM_MALLOC_H
+#define HOST_UMM_MALLOC_H
+
+// Host stand-in for the umm_malloc full statistics (UMM_STATS_FULL).
+// malloc/realloc/free are wrapped in Heap.cpp to count calls, the bytes they
+// hold since hostHeapReset() are taken from a simulated HOST_HEAP_BYTES heap.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HOST_HEAP_BYTES (52 * 1024)
+
+size_t umm_get_malloc_count();
+size_t umm_get_realloc_count();
+size_t umm_get_free_count();
+size_t umm_free_heap_size_min();
+size_t umm_free_heap_size_min_reset();
+
+// Host only
+void hostHeapReset();
+uint32_t hostHeapFree();
+
+// Host only: memory the device would not hold, e.g. captured response bodies,
+// stays out of the simulated heap
+void *hostUntrackedAlloc(size_t size);
+void hostUntrackedFree(void *ptr);
+
+template <typename T>
+struct HostUntrackedAllocator {
+  typedef T value_type;
+  HostUntrackedAllocator() = default;
+  template <typename U> HostUntrackedAllocator(const HostUntrackedAllocator<U> &) {}
+  T *allocate(size_t n) { return (T *) hostUntrackedAlloc(n * sizeof(T)); }
+  void deallocate(T *ptr, size_t) { hostUntrackedFree(ptr); }
+  template <typename U> bool operator==(const HostUntrackedAllocator<U> &) const { return true; }
+  template <typename U> bool operator!=(const HostUntrackedAllocator<U> &) const { return false; }
+};
+
+#endif
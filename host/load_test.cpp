@@ -0,0 +1,250 @@
+// Concurrent HTTP clients against Webserver while the control loop runs.
+// Built twice from this file: load_test on ESP8266WebServer and
+// load_test_multi on MultiWebServer (WEB_BACKEND_MULTI=1).
+//
+// Browser clients read at a fixed rate, like a phone on weak Wi-Fi, and cycle
+// over the dashboard files and JSON endpoints. One more client scrapes
+// /api/prometheus at LAN speed. The simulated clock advances 1 ms per loop
+// pass, and while a blocking write waits for the client, so the time spent
+// in handleClient() is what the pump and sensor jobs lose.
+// With --keep-alive each client reuses its connection while the server keeps
+// it open, and with --pipeline N it keeps up to N requests in flight on it.
+
+#include "HostSim.h"
+#include "../consts.h"
+#include "../app.h"
+#include "../config.h"
+#include "../utils.h"
+#include "../webserver.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+
+#if WEB_BACKEND_MULTI
+#define BACKEND_NAME "MultiWebServer"
+#else
+#define BACKEND_NAME "ESP8266WebServer"
+#endif
+
+EspSaveCrash crashHandler(0, 3072);
+
+static const char *uris[] = {"/", "/edit", "/list?dir=/", "/api/status", "/state"};
+#define URI_COUNT (sizeof(uris) / sizeof(uris[0]))
+#define SCRAPE_URI "/api/prometheus"
+
+typedef struct {
+  const char *uri;
+  uint64_t startUs;
+} PendingRequest;
+
+typedef struct {
+  std::shared_ptr<HostConnection> connection;
+  size_t consumed; // Bytes of connection->received already matched to responses
+  bool closing; // The server announced it closes the connection
+  unsigned int done; // Requests completed
+  unsigned int sent;
+  unsigned int uri; // Next one to request
+  std::deque<PendingRequest> pending; // Sent, not answered yet, oldest first
+  size_t rate;
+  bool scraper;
+} LoadClient;
+
+typedef struct {
+  unsigned long count;
+  unsigned long failed;
+  unsigned long bytes;
+  std::vector<uint64_t> latencyUs;
+} UriResult;
+
+static uint64_t percentile(std::vector<uint64_t> values, double p) {
+  if (values.empty())
+    return 0;
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, (size_t) (p * values.size()))];
+}
+
+static const char *nextUri(LoadClient &client) {
+  if (client.scraper)
+    return SCRAPE_URI;
+  const char *uri = uris[client.uri];
+  client.uri = (client.uri + 1) % URI_COUNT;
+  return uri;
+}
+
+static unsigned long connections = 0;
+
+static void sendRequest(LoadClient &client, const PendingRequest &request, bool keepAlive) {
+  if (!client.connection) {
+    client.connection = HostNetwork::connect(80, client.rate);
+    client.consumed = 0;
+    client.closing = false;
+    connections++;
+  }
+  const char *uri = request.uri;
+  client.pending.push_back(request);
+  client.connection->peerWrite(std::string("GET ") + uri + " HTTP/1.1\r\nHost: pool\r\nUser-Agent: load_test\r\n" +
+                               (keepAlive ? "" : "Connection: close\r\n") + "\r\n");
+}
+
+// Length of the response at the start of data once it is complete, 0 before.
+// Bodies without Content-Length nor chunks end with the connection (closed).
+static size_t responseLength(const std::string &data, size_t start, bool closed) {
+  size_t headerEnd = data.find("\r\n\r\n", start);
+  if (headerEnd == std::string::npos)
+    return 0;
+  headerEnd += 4;
+  std::string head = data.substr(start, headerEnd - start);
+  std::transform(head.begin(), head.end(), head.begin(), ::tolower);
+  if (head.compare(0, 12, "http/1.1 304") == 0 || head.compare(0, 12, "http/1.0 304") == 0)
+    return headerEnd - start;
+  size_t length = head.find("content-length: ");
+  if (length != std::string::npos) {
+    size_t end = headerEnd + strtoul(head.c_str() + length + 16, nullptr, 10);
+    return data.size() >= end ? end - start : 0;
+  }
+  if (head.find("transfer-encoding: chunked") != std::string::npos) {
+    size_t end = data.find("\r\n0\r\n\r\n", headerEnd - 2);
+    return end == std::string::npos ? 0 : end + 7 - start;
+  }
+  return closed ? data.size() - start : 0;
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s [--clients N] [--requests N] [--rate BYTES_PER_MS] [--scraper-rate BYTES_PER_MS] [--keep-alive] [--pipeline N] [--fs DIR]\n", name);
+  printf("  --scraper-rate 0 leaves the Prometheus scraper out\n");
+  printf("  --pipeline N keeps up to N requests in flight per connection, implies --keep-alive\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned int clients = 4;
+  unsigned int requests = 30; // Per client
+  size_t rate = 20; // Bytes per ms, 20 kB/s
+  size_t scraperRate = 1000;
+  bool keepAlive = false;
+  unsigned int depth = 1; // Requests in flight per client
+  std::string fsDir = "/tmp/pool-load-fs";
+
+  for (int i = 1; i < argc; i++) {
+    std::string opt(argv[i]);
+    if (opt == "--clients" && i + 1 < argc) clients = strtoul(argv[++i], nullptr, 10);
+    else if (opt == "--requests" && i + 1 < argc) requests = strtoul(argv[++i], nullptr, 10);
+    else if (opt == "--rate" && i + 1 < argc) rate = strtoul(argv[++i], nullptr, 10);
+    else if (opt == "--scraper-rate" && i + 1 < argc) scraperRate = strtoul(argv[++i], nullptr, 10);
+    else if (opt == "--keep-alive") keepAlive = true;
+    else if (opt == "--pipeline" && i + 1 < argc) { depth = strtoul(argv[++i], nullptr, 10); keepAlive = true; }
+    else if (opt == "--fs" && i + 1 < argc) fsDir = argv[++i];
+    else { usage(argv[0]); return 1; }
+  }
+  if (rate == 0)
+    rate = 1;
+  if (depth == 0)
+    depth = 1;
+
+  hostSimSetup(fsDir);
+  Log.setSerialLevel(LOG_LEVEL_ERROR);
+  App *app = new App();
+  Webserver *httpServer = new Webserver(app, &crashHandler, 80);
+  httpServer->begin();
+
+  std::vector<LoadClient> load(clients + (scraperRate ? 1 : 0));
+  for (unsigned int i = 0; i < load.size(); i++) {
+    load[i].uri = i % URI_COUNT;
+    load[i].scraper = i == clients;
+    load[i].rate = load[i].scraper ? scraperRate : rate;
+  }
+
+  std::map<std::string, UriResult> results;
+  unsigned long retried = 0; // Requests left unanswered by a closing server, pipelined or racing an eviction
+  std::vector<uint64_t> httpUs; // Simulated time in handleClient() per pass
+  std::vector<uint64_t> loopUs; // Simulated time per pass, the nominal 1 ms included
+  unsigned int finished = 0;
+  const uint64_t start = HostHardware::uptimeUs;
+  const uint64_t limit = start + 3600ULL * 1000000;
+
+  while (finished < load.size() && HostHardware::uptimeUs < limit) {
+    uint64_t passStart = HostHardware::uptimeUs;
+    httpServer->handleClient();
+    httpUs.push_back(HostHardware::uptimeUs - passStart);
+    app->update();
+    httpServer->serviceEvents();
+    Log.stream(Serial);
+    HostHardware::advanceMs(1);
+    loopUs.push_back(HostHardware::uptimeUs - passStart);
+
+    for (LoadClient &client : load) {
+      if (client.done == requests)
+        continue;
+
+      if (client.connection) {
+        const std::string &received = client.connection->received;
+        bool closed = client.connection->serverClosed && client.connection->toClient.empty();
+        size_t length;
+        while (!client.pending.empty() && (length = responseLength(received, client.consumed, closed)) > 0) {
+          UriResult &result = results[client.pending.front().uri];
+          result.count++;
+          result.bytes += length;
+          result.latencyUs.push_back(HostHardware::uptimeUs - client.pending.front().startUs);
+          if (received.compare(client.consumed, 12, "HTTP/1.1 200") != 0 && received.compare(client.consumed, 12, "HTTP/1.0 200") != 0 &&
+              received.compare(client.consumed, 12, "HTTP/1.1 304") != 0)
+            result.failed++;
+          size_t headerEnd = received.find("\r\n\r\n", client.consumed);
+          if (received.substr(client.consumed, headerEnd - client.consumed).find("Connection: close") != std::string::npos)
+            client.closing = true;
+          client.consumed += length;
+          client.pending.pop_front();
+          if (++client.done == requests)
+            finished++;
+        }
+        if (closed) {
+          // Sent again on the next connection
+          retried += client.pending.size();
+          std::deque<PendingRequest> unanswered;
+          unanswered.swap(client.pending);
+          client.connection.reset();
+          for (const PendingRequest &request : unanswered)
+            sendRequest(client, request, keepAlive);
+        }
+      }
+
+      while (client.sent < requests && client.pending.size() < depth && (!client.connection || (keepAlive && !client.closing))) {
+        sendRequest(client, {nextUri(client), HostHardware::uptimeUs}, keepAlive);
+        client.sent++;
+      }
+    }
+  }
+
+  double seconds = (HostHardware::uptimeUs - start) / 1e6;
+  unsigned long totalRequests = 0, totalBytes = 0, totalFailed = 0;
+  for (auto const &kv : results) {
+    totalRequests += kv.second.count;
+    totalBytes += kv.second.bytes;
+    totalFailed += kv.second.failed;
+  }
+
+  printf("%s, %u clients x %u requests at %zu kB/s each", BACKEND_NAME, clients, requests, rate);
+  if (scraperRate)
+    printf(", scraper at %zu kB/s", scraperRate);
+  if (depth > 1)
+    printf(", keep-alive, %u in flight", depth);
+  else if (keepAlive)
+    printf(", keep-alive");
+  printf("\n");
+  printf("Completed %lu requests (%lu failed) in %.1f simulated s: %.1f req/s, %.1f kB/s\n", totalRequests, totalFailed,
+         seconds, totalRequests / seconds, totalBytes / seconds / 1000.0);
+  printf("Connections %lu, %.1f requests each, %lu requests sent again after a close\n", connections,
+         connections ? (double) totalRequests / connections : 0.0, retried);
+  printf("Latency per URI (simulated ms):\n");
+  for (auto const &kv : results)
+    printf("  %-18s %5lu req  %7lu B  p50 %8.1f  p99 %8.1f  max %8.1f\n", kv.first.c_str(), kv.second.count,
+           kv.second.count ? kv.second.bytes / kv.second.count : 0, percentile(kv.second.latencyUs, 0.5) / 1000.0,
+           percentile(kv.second.latencyUs, 0.99) / 1000.0, percentile(kv.second.latencyUs, 1.0) / 1000.0);
+  printf("Control loop over %zu passes (simulated ms):\n", loopUs.size());
+  printf("  handleClient      p50 %8.3f  p99 %8.3f  p99.9 %8.3f  max %8.3f\n", percentile(httpUs, 0.5) / 1000.0,
+         percentile(httpUs, 0.99) / 1000.0, percentile(httpUs, 0.999) / 1000.0, percentile(httpUs, 1.0) / 1000.0);
+  printf("  loop period       p50 %8.3f  p99 %8.3f  p99.9 %8.3f  max %8.3f\n", percentile(loopUs, 0.5) / 1000.0,
+         percentile(loopUs, 0.99) / 1000.0, percentile(loopUs, 0.999) / 1000.0, percentile(loopUs, 1.0) / 1000.0);
+  return totalFailed ? 2 : 0;
+}
@@ -0,0 +1,149 @@
+// Host simulation of the pool controller.
+// Runs App and Webserver against the fake hardware with an accelerated clock
+// and reports what the control loop and the HTTP handlers cost.
+
+#include "HostSim.h"
+#include "../consts.h"
+#include "../app.h"
+#include "../config.h"
+#include "../utils.h"
+#include "../webserver.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+EspSaveCrash crashHandler(0, 3072);
+
+typedef struct {
+  unsigned long count;
+  uint64_t totalNs;
+  uint64_t maxNs;
+} Cost;
+
+static void account(Cost &cost, uint64_t ns) {
+  cost.count++;
+  cost.totalNs += ns;
+  cost.maxNs = std::max(cost.maxNs, ns);
+}
+
+static void printCost(const char *name, const Cost &cost) {
+  printf("  %-22s %10lu calls  mean %9.1f us  max %9.1f us\n", name, cost.count,
+         cost.count ? cost.totalNs / 1000.0 / cost.count : 0.0, cost.maxNs / 1000.0);
+}
+
+static void usage(const char *name) {
+  printf("Usage: %s [--days N] [--step-ms MS] [--http-every S] [--fs DIR] [--get URI]... [--verbose]\n", name);
+}
+
+int main(int argc, char **argv) {
+  double days = 1;
+  unsigned long stepMs = 100;
+  unsigned long httpEvery = 10;
+  std::string fsDir = "pool_fs";
+  std::vector<std::string> dumps;
+
+  for (int i = 1; i < argc; i++) {
+    std::string opt(argv[i]);
+    if (opt == "--days" && i + 1 < argc) days = atof(argv[++i]);
+    else if (opt == "--step-ms" && i + 1 < argc) stepMs = strtoul(argv[++i], nullptr, 10);
+    else if (opt == "--http-every" && i + 1 < argc) httpEvery = strtoul(argv[++i], nullptr, 10);
+    else if (opt == "--fs" && i + 1 < argc) fsDir = argv[++i];
+    else if (opt == "--get" && i + 1 < argc) dumps.push_back(argv[++i]);
+    else if (opt == "--verbose") HardwareSerial::echo = true;
+    else { usage(argv[0]); return 1; }
+  }
+
+  hostSimSetup(fsDir);
+
+  App *app = new App();
+  Webserver *httpServer = new Webserver(app, &crashHandler, 80);
+  httpServer->begin();
+
+  const time_t start = HostHardware::epoch;
+  const time_t end = start + (time_t) (days * 86400);
+  const char *routes[] = {"/api/status", "/api/prometheus", "/state", "/"};
+  std::map<std::string, Cost> httpCosts;
+  std::map<std::string, String> etags; // Revalidated like a browser would
+  unsigned long httpRequests = 0, notModified = 0;
+  Cost updateCost = {0, 0, 0};
+  uint64_t maxStallUs = 0;
+  unsigned long pumpSwitches = 0;
+  uint8_t relay = digitalRead(GPIO_RELAY);
+  time_t nextHttp = start;
+
+  while (HostHardware::epoch < end) {
+    // Water temperature follows a daily sine between 18 and 26 C
+    double dayPhase = fmod((double) HostHardware::epoch, 86400.0) / 86400.0;
+    HostHardware::waterTemperature = 22.0f + 4.0f * sin(2 * M_PI * (dayPhase - 0.375));
+    // Filter pressure sensor: ~1.4 V with the pump running, ~0.3 V at rest, +-6 counts of noise
+    HostHardware::adcValue = digitalRead(GPIO_RELAY) ? 420 : 100;
+    HostHardware::adcNoise = 6;
+
+    // Phases timed like loop() does
+    uint32_t mark = ESP.getCycleCount();
+    httpServer->handleClient();
+    mark = app->recordLoopPhase(LOOP_PHASE_HTTP, mark);
+
+    uint64_t simBefore = HostHardware::uptimeUs;
+    account(updateCost, hostMeasureNs([&]() { app->update(); }));
+    maxStallUs = std::max(maxStallUs, HostHardware::uptimeUs - simBefore);
+    mark = app->recordLoopPhase(LOOP_PHASE_APP, mark);
+    httpServer->serviceEvents();
+    mark = app->recordLoopPhase(LOOP_PHASE_EVENTS, mark);
+    httpServer->servicePush();
+    mark = app->recordLoopPhase(LOOP_PHASE_PUSH, mark);
+    Log.stream(Serial);
+    app->recordLoopPhase(LOOP_PHASE_LOG, mark);
+    Heap.sample();
+
+    if (digitalRead(GPIO_RELAY) != relay) {
+      relay = digitalRead(GPIO_RELAY);
+      pumpSwitches++;
+      time_t now = get_time();
+      char when[32];
+      strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", localtime(&now));
+      printf("%s pump %s\n", when, relay ? "ON" : "OFF");
+    }
+
+    if (httpEvery && HostHardware::epoch >= nextHttp) {
+      nextHttp = HostHardware::epoch + httpEvery;
+      for (const char *route : routes) {
+        HostResponse response;
+        std::vector<std::pair<String, String>> headers;
+        if (etags[route].length())
+          headers.push_back({"If-None-Match", etags[route]});
+        account(httpCosts[route], hostMeasureNs([&]() { response = httpServer->hostRequest(HTTP_GET, route, String(), headers); }));
+        etags[route] = response.header("ETag");
+        httpRequests++;
+        if (response.code == 304)
+          notModified++;
+      }
+    }
+
+    HostHardware::advanceMs(stepMs);
+  }
+
+  printf("\nSimulated %.2f day(s) in %lu loop passes (%lu ms per pass)\n", days, updateCost.count, stepMs);
+  printf("Pump switches: %lu, DS18B20 requests: %lu, pool reader reads: %lu, ADC reads: %lu\n", pumpSwitches,
+         HostHardware::dallasRequests, HostHardware::poolReaderReads, HostHardware::adcReads);
+  printf("HTTP requests: %lu, 304 Not Modified: %lu\n", httpRequests, notModified);
+  printf("Longest simulated loop stall: %.1f ms\n", maxStallUs / 1000.0);
+  printf("Host CPU cost:\n");
+  printCost("App::update", updateCost);
+  for (auto const &kv : httpCosts)
+    printCost(kv.first.c_str(), kv.second);
+
+  // Responses at the end of the run, e.g. --get /api/status
+  for (auto const &uri : dumps) {
+    HostResponse response = httpServer->hostRequest(HTTP_GET, uri.c_str());
+    printf("\nGET %s -> %d %s\n", uri.c_str(), response.code, response.contentType.c_str());
+    for (auto const &h : response.headers)
+      printf("%s: %s\n", h.first.c_str(), h.second.c_str());
+    printf("\n%s\n", response.body.c_str());
+  }
+
+  return 0;
+}
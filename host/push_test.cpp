@@ -0,0 +1,216 @@
+// Metrics push mode against a stand-in endpoint, built with METRICS_PUSH=1 and
+// short intervals (see CMakeLists.txt). The endpoint is a WiFiServer of the
+// simulation on METRICS_PUSH_PORT which decodes the chunked POSTs and answers
+// 204. The run goes through an outage, first with nobody listening then with
+// 503 answers, and checks that once the endpoint is back every batch still
+// queued arrives, oldest first, with the time it was captured.
+
+#include "HostSim.h"
+#include "../consts.h"
+#include "../app.h"
+#include "../config.h"
+#include "../utils.h"
+#include "../webserver.h"
+
+#include <stdio.h>
+#include <set>
+#include <vector>
+
+EspSaveCrash crashHandler(0, 3072);
+
+typedef enum {
+  ENDPOINT_UP,
+  ENDPOINT_DOWN, // Not listening, connect() fails
+  ENDPOINT_ERROR // Answers 503
+} EndpointMode;
+
+typedef struct {
+  time_t time; // Timestamp of the samples, s
+  time_t receivedAt; // Simulated clock, s
+  size_t samples;
+} ReceivedBatch;
+
+typedef struct {
+  WiFiClient client;
+  std::string request;
+} EndpointConnection;
+
+static WiFiServer endpoint(METRICS_PUSH_PORT);
+static std::vector<EndpointConnection> connections;
+static std::vector<ReceivedBatch> received;
+static unsigned long malformed = 0;
+
+// Sample lines of a timestamped exposition body: every one must carry the same time
+static bool decode(const std::string &body, ReceivedBatch &batch) {
+  batch.samples = 0;
+  batch.time = 0;
+  size_t start = 0;
+  while (start < body.size()) {
+    size_t end = body.find('\n', start);
+    if (end == std::string::npos)
+      return false;
+    std::string line = body.substr(start, end - start);
+    start = end + 1;
+    if (line.empty() || line[0] == '#')
+      continue;
+    size_t space = line.rfind(' ');
+    if (space == std::string::npos)
+      return false;
+    time_t time = strtoll(line.c_str() + space + 1, nullptr, 10) / 1000;
+    if (batch.samples > 0 && time != batch.time)
+      return false;
+    batch.time = time;
+    batch.samples++;
+  }
+  return batch.samples > 0;
+}
+
+// Body of a complete chunked request, false while more is expected
+static bool dechunk(const std::string &request, std::string &body) {
+  size_t at = request.find("\r\n\r\n");
+  if (at == std::string::npos)
+    return false;
+  at += 4;
+  body.clear();
+  while (true) {
+    size_t line = request.find("\r\n", at);
+    if (line == std::string::npos)
+      return false;
+    size_t size = strtoul(request.c_str() + at, nullptr, 16);
+    if (size == 0)
+      return request.size() >= line + 4;
+    if (request.size() < line + 2 + size + 2)
+      return false;
+    body.append(request, line + 2, size);
+    at = line + 2 + size + 2;
+  }
+}
+
+static void serviceEndpoint(EndpointMode mode) {
+  while (endpoint.hasClient())
+    connections.push_back({endpoint.accept(), std::string()});
+  for (size_t i = 0; i < connections.size();) {
+    EndpointConnection &c = connections[i];
+    while (c.client.available() > 0)
+      c.request += (char) c.client.read();
+    std::string body;
+    if (!dechunk(c.request, body)) {
+      i++;
+      continue;
+    }
+    if (c.request.compare(0, 5 + strlen(METRICS_PUSH_PATH), "POST " METRICS_PUSH_PATH) != 0)
+      malformed++;
+    if (mode == ENDPOINT_ERROR) {
+      c.client.print("HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n");
+    } else {
+      ReceivedBatch batch;
+      if (decode(body, batch)) {
+        batch.receivedAt = get_time();
+        received.push_back(batch);
+      } else {
+        malformed++;
+      }
+      c.client.print("HTTP/1.1 204 No Content\r\n\r\n");
+    }
+    c.client.stop();
+    connections.erase(connections.begin() + i);
+  }
+}
+
+int main(int argc, char **argv) {
+  hostSimSetup(argc > 1 ? argv[1] : "/tmp/pool-push-fs");
+  Log.setSerialLevel(LOG_LEVEL_ERROR);
+  App *app = new App();
+  Webserver *httpServer = new Webserver(app, &crashHandler, 80);
+  httpServer->begin();
+  endpoint.begin();
+
+  // Minutes of simulated time in each mode
+  const struct { EndpointMode mode; unsigned int minutes; const char *name; } phases[] = {
+    {ENDPOINT_UP, 5, "up"},
+    {ENDPOINT_DOWN, 3, "not listening"},
+    {ENDPOINT_ERROR, 2, "503"},
+    {ENDPOINT_UP, 5, "up"},
+  };
+  const time_t start = get_time();
+  time_t outageStart = 0, outageEnd = 0;
+
+  for (auto const &phase : phases) {
+    if (phase.mode == ENDPOINT_DOWN)
+      endpoint.close();
+    else
+      endpoint.begin();
+    if (phase.mode != ENDPOINT_UP && !outageStart)
+      outageStart = get_time();
+    else if (phase.mode == ENDPOINT_UP && outageStart && !outageEnd)
+      outageEnd = get_time();
+    printf("%4lds endpoint %s\n", (long) (get_time() - start), phase.name);
+
+    for (unsigned long step = 0; step < phase.minutes * 600UL; step++) {
+      httpServer->handleClient();
+      app->update();
+      httpServer->servicePush();
+      serviceEndpoint(phase.mode);
+      Log.stream(Serial);
+      HostHardware::advanceMs(100);
+    }
+  }
+
+  // Scrape to read the push metrics back, and to compare with the pushed series
+  auto connection = HostNetwork::connect(80, 1000);
+  connection->peerWrite("GET /api/prometheus HTTP/1.1\r\nConnection: close\r\n\r\n");
+  for (int i = 0; i < 1000 && !(connection->serverClosed && connection->toClient.empty()); i++) {
+    httpServer->handleClient();
+    HostHardware::advanceMs(1);
+  }
+  std::string scrape;
+  dechunk(connection->received, scrape);
+  size_t scrapeSamples = 0;
+  for (size_t at = 0; at < scrape.size(); at = scrape.find('\n', at) + 1)
+    if (scrape[at] != '#')
+      scrapeSamples++;
+  scrape = "\n" + scrape;
+  auto metric = [&scrape](const char *name) {
+    size_t at = scrape.find(std::string("\n") + name + " ");
+    return at == std::string::npos ? -1.0 : atof(scrape.c_str() + at + strlen(name) + 2);
+  };
+
+  unsigned long captured = (get_time() - start) / METRICS_PUSH_SAMPLE_S + 1;
+  bool ordered = true;
+  std::set<time_t> times;
+  size_t minSamples = (size_t) -1, maxSamples = 0;
+  for (size_t i = 0; i < received.size(); i++) {
+    if (i > 0 && received[i].time <= received[i - 1].time)
+      ordered = false;
+    times.insert(received[i].time);
+    minSamples = std::min(minSamples, received[i].samples);
+    maxSamples = std::max(maxSamples, received[i].samples);
+  }
+  // Batches captured during the outage, sent once it was over
+  size_t recovered = 0;
+  time_t oldestLag = 0;
+  for (const ReceivedBatch &batch : received) {
+    if (batch.time < outageStart || batch.time >= outageEnd)
+      continue;
+    recovered++;
+    oldestLag = std::max(oldestLag, batch.receivedAt - batch.time);
+  }
+
+  double dropped = metric("pool_push_dropped_samples_total");
+  printf("Captured %lu batches every %us, pushed every %us, queue of %u\n", captured, METRICS_PUSH_SAMPLE_S,
+         METRICS_PUSH_INTERVAL_S, METRICS_PUSH_QUEUE);
+  printf("Received %zu batches (%zu to %zu samples each, %zu in a scrape), %lu malformed, %s\n", received.size(),
+         minSamples, maxSamples, scrapeSamples, malformed, ordered ? "in capture order" : "OUT OF ORDER");
+  printf("Captured during the %lds outage and delivered after it: %zu batches, the oldest %lds after its capture\n",
+         (long) (outageEnd - outageStart), recovered, (long) oldestLag);
+  printf("pool_push_queue_batches %.0f  pool_push_batches_total %.0f  pool_push_failures_total %.0f\n",
+         metric("pool_push_queue_batches"), metric("pool_push_batches_total"), metric("pool_push_failures_total"));
+  printf("pool_push_dropped_samples_total %.0f (%.1f batches)  pool_push_last_latency_us %.0f\n", dropped,
+         maxSamples ? dropped / maxSamples : 0.0, metric("pool_push_last_latency_us"));
+
+  bool ok = !received.empty() && ordered && malformed == 0 && times.size() == received.size() &&
+            recovered >= METRICS_PUSH_QUEUE - 1 && dropped > 0 &&
+            received.size() + (unsigned long) (dropped / maxSamples + 0.5) + (unsigned long) metric("pool_push_queue_batches") >= captured - 1;
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 2;
+}
@@ -1,44 +1,296 @@
 #ifndef MINI_PROM_CLIENT
 #define MINI_PROM_CLIENT
 
+#include <Arduino.h>
+#include "WebServerBackend.h"
+#include <algorithm>
+#include "LatencyHistogram.h"
+#include "HeapMonitor.h"
+
 #define GAUGE "gauge"
 #define SUMMARY "summary"
 #define COUNTER "counter"
+#define HISTOGRAM "histogram"
+
+#define PROM_BUFFER_SIZE 256
+#define PROM_CONTENT_TYPE "text/plain; version=0.0.4"
+
+// Values of one pass over the metrics, in the order they were written. Names,
+// HELP and labels are not kept: they come from flash when the batch is replayed
+// through the same pass, which is why a batch is this small. The owner gives
+// the slots (32-bit values, histogram sums take two); a capture into a batch
+// without any tells how many the pass needs.
+typedef struct {
+    time_t time;
+    uint32_t seq;
+    uint16_t count; // Slots used
+    uint16_t needed; // Slots the pass asked for, more than count when some did not fit
+    uint16_t samples; // Sample lines they make
+    uint16_t missing; // Sample lines lost because capacity was too small
+    uint16_t capacity;
+    uint32_t * values;
+} PromBatch;
 
+// Prometheus text exposition written straight to the HTTP client.
+// Lines are formatted into a fixed buffer which is sent as one chunk each time
+// it fills up. Names and HELP text come from flash (F()), so a scrape uses the
+// same memory whatever the number of metrics.
+//
+//   MiniPromClient client(server);
+//   client.begin();
+//   client.family(F("pool_pump_status"), F("Pump relay state"), GAUGE);
+//   client.sample(1);
+//   client.end();
+//
+// The same pass can also capture the values into a PromBatch without writing
+// anything, then replay them later to a Print with the batch timestamp, the
+// values passed to sample() being ignored. The pass must produce the same
+// series both times.
 class MiniPromClient
 {
 private:
-    String o1;
+    WebServerBackend * server = nullptr;
+    Print * out = nullptr;
+    PromBatch * capture = nullptr;
+    const PromBatch * replay = nullptr;
+    bool timestamps = false;
+    uint16_t cursor = 0; // Next slot of replay
+    const __FlashStringHelper * name = nullptr;
+    char buffer[PROM_BUFFER_SIZE];
+    size_t length = 0;
+
+    void flush(){
+        if (this->length == 0)
+          return;
+        Heap.sample();
+        if (this->server)
+          this->server->sendContent(this->buffer, this->length);
+        else if (this->out)
+          this->out->write((const uint8_t *) this->buffer, this->length);
+        this->length = 0;
+    };
+
+    // Stores the value when capturing (nothing to write then), loads it when replaying.
+    // False when the sample must not be written
+    template <typename T>
+    bool record(T &value){
+        const uint16_t slots = (sizeof(T) + 3) / 4;
+        if (this->capture) {
+          this->capture->needed += slots;
+          if (this->capture->count + slots > this->capture->capacity) {
+            this->capture->missing++;
+            return false;
+          }
+          memcpy(this->capture->values + this->capture->count, &value, sizeof(T));
+          this->capture->count += slots;
+          this->capture->samples++;
+          return false;
+        }
+        if (this->replay) {
+          if (this->cursor + slots > this->replay->count)
+            return false;
+          memcpy(&value, this->replay->values + this->cursor, sizeof(T));
+          this->cursor += slots;
+        }
+        return true;
+    };
+
+    void append(const char * data, size_t size){
+        if (this->capture)
+          return;
+        while (size > 0) {
+          if (this->length == PROM_BUFFER_SIZE)
+            flush();
+          size_t n = std::min(size, PROM_BUFFER_SIZE - this->length);
+          memcpy(this->buffer + this->length, data, n);
+          this->length += n;
+          data += n;
+          size -= n;
+        }
+    };
 
-    void writeDesc(String name, String help){
-        this->o1 += "# HELP " + name + " " + help + "\n";
+    void append(const char * str){
+        append(str, strlen(str));
     };
 
-    void writeType(String &name, const char * type){
-        this->o1 += "# TYPE " + name + " " + String(type) + "\n";
+    void append(const __FlashStringHelper * str){
+        if (this->capture)
+          return;
+        PGM_P p = reinterpret_cast<PGM_P>(str);
+        size_t size = strlen_P(p);
+        while (size > 0) {
+          if (this->length == PROM_BUFFER_SIZE)
+            flush();
+          size_t n = std::min(size, PROM_BUFFER_SIZE - this->length);
+          memcpy_P(this->buffer + this->length, p, n);
+          this->length += n;
+          p += n;
+          size -= n;
+        }
+    };
+
+    void beginSample(const __FlashStringHelper * label, const char * labelValue, const char * suffix = nullptr, const char * le = nullptr){
+        append(this->name);
+        if (suffix)
+          append(suffix);
+        if (label || le) {
+          append("{", 1);
+          if (label) {
+            append(label);
+            append("=\"", 2);
+            append(labelValue);
+            append("\"", 1);
+          }
+          if (le) {
+            append(label ? ",le=\"" : "le=\"");
+            append(le);
+            append("\"", 1);
+          }
+          append("}", 1);
+        }
+        append(" ", 1);
+    };
+
+    void endSample(const char * value){
+        append(value);
+        if (this->replay && this->timestamps) {
+          char time[24];
+          snprintf(time, sizeof(time), " %lld000", (long long) this->replay->time);
+          append(time);
+        }
+        append("\n", 1);
     };
 
 public:
-    MiniPromClient(){
+    MiniPromClient(WebServerBackend &server) : server(&server) {
     };
 
-    void put(String name, String labels,  String value , String help , const char * type){
-        writeDesc(name, help);
-        writeType(name, type);
-        put(name, value, labels);
+    // Fills batch with the values of the pass, up to its capacity
+    MiniPromClient(PromBatch &batch) : capture(&batch) {
+        batch.count = 0;
+        batch.needed = 0;
+        batch.samples = 0;
+        batch.missing = 0;
     };
 
-    void put(String name, String value){ 
-        put(name,"", value);
-    }
+    // Writes the pass to out with the values of batch, timestamped with its time when asked
+    MiniPromClient(Print &out, const PromBatch &batch, bool timestamps) : out(&out), replay(&batch), timestamps(timestamps) {
+    };
+
+    // Starts the chunked response, HTTP/1.0 clients get a close-delimited body instead
+    void begin(){
+        if (!this->server)
+          return;
+        if (!this->server->chunkedResponseModeStart_P(200, PSTR(PROM_CONTENT_TYPE))) {
+          this->server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+          this->server->send_P(200, PSTR(PROM_CONTENT_TYPE), PSTR(""));
+        }
+    };
+
+    void end(){
+        flush();
+        if (this->server)
+          this->server->chunkedResponseFinalize();
+    };
 
-    void put(String name, String labels, String value){
-        this->o1 += "" + name + "{" +labels + "} " + value +"\n";
-    }
+    // False when a replay did not use every value of its batch, the series changed since the capture
+    bool complete() const { return !this->replay || this->cursor == this->replay->count; };
 
-    String getMessage(){
-      return o1;
-    }
+    // HELP and TYPE lines, following samples use this name
+    void family(const __FlashStringHelper * name, const __FlashStringHelper * help, const char * type){
+        this->name = name;
+        append("# HELP ", 7);
+        append(name);
+        append(" ", 1);
+        append(help);
+        append("\n# TYPE ", 8);
+        append(name);
+        append(" ", 1);
+        append(type);
+        append("\n", 1);
+    };
+
+    void sample(float value, const __FlashStringHelper * label = nullptr, const char * labelValue = nullptr){
+        if (!record(value))
+          return;
+        char str[24];
+        snprintf(str, sizeof(str), "%.2f", value);
+        beginSample(label, labelValue);
+        endSample(str);
+    };
+
+    void sample(unsigned long value, const __FlashStringHelper * label = nullptr, const char * labelValue = nullptr){
+        uint32_t slot = value; // 32 bits on the ESP8266, whatever the host says
+        if (!record(slot))
+          return;
+        value = slot;
+        char str[24];
+        snprintf(str, sizeof(str), "%lu", value);
+        beginSample(label, labelValue);
+        endSample(str);
+    };
+
+    void sample(long value, const __FlashStringHelper * label = nullptr, const char * labelValue = nullptr){
+        int32_t slot = value;
+        if (!record(slot))
+          return;
+        value = slot;
+        char str[24];
+        snprintf(str, sizeof(str), "%ld", value);
+        beginSample(label, labelValue);
+        endSample(str);
+    };
+
+    void sample(unsigned int value, const __FlashStringHelper * label = nullptr, const char * labelValue = nullptr){
+        sample((unsigned long) value, label, labelValue);
+    };
+
+    void sample(int value, const __FlashStringHelper * label = nullptr, const char * labelValue = nullptr){
+        sample((long) value, label, labelValue);
+    };
+
+    void sample(bool value, const __FlashStringHelper * label = nullptr, const char * labelValue = nullptr){
+        sample((unsigned long) (value ? 1 : 0), label, labelValue);
+    };
+
+    // _bucket (cumulative), _sum and _count samples of a HISTOGRAM family, in microseconds
+    void histogram(const LatencyHistogram &histogram, const __FlashStringHelper * label = nullptr, const char * labelValue = nullptr){
+        char le[12];
+        char str[24];
+        uint32_t cumulative = 0;
+        for (uint8_t i = 0; i < LATENCY_BUCKETS; i++) {
+          cumulative += histogram.getCounts()[i];
+          uint32_t value = cumulative;
+          if (!record(value))
+            continue;
+          if (i < LATENCY_BUCKETS - 1)
+            snprintf(le, sizeof(le), "%lu", (unsigned long) latencyBounds[i]);
+          else
+            strcpy(le, "+Inf");
+          snprintf(str, sizeof(str), "%lu", (unsigned long) value);
+          beginSample(label, labelValue, "_bucket", le);
+          endSample(str);
+        }
+        uint64_t sum = histogram.getSum();
+        if (record(sum)) {
+          snprintf(str, sizeof(str), "%llu", (unsigned long long) sum);
+          beginSample(label, labelValue, "_sum");
+          endSample(str);
+        }
+        uint32_t count = histogram.getCount();
+        if (record(count)) {
+          snprintf(str, sizeof(str), "%lu", (unsigned long) count);
+          beginSample(label, labelValue, "_count");
+          endSample(str);
+        }
+    };
+
+    // Single sample family
+    template <typename T>
+    void put(const __FlashStringHelper * name, const __FlashStringHelper * help, const char * type, T value){
+        family(name, help, type);
+        sample(value);
+    };
 };
 
 
@@ -29,7 +29,7 @@ extern "C" int clock_gettime(clockid_t unused, struct timespec *tp);
 static bool isTimeSet = false;
 static bool hasOTAStarted = false;
 Webserver *httpServer;
-App *app;
+App *app = nullptr;
 EspSaveCrash crashHandler(0, 3072);
 
 DynamicJsonDocument config(3072); //3k bytes for the JsonDocument
@@ -38,8 +38,12 @@ DynamicJsonDocument config(3072); //3k bytes for the JsonDocument
   Serial.print(" " #w "="); \
   Serial.print(tm->tm_##w);
 
+time_t get_time(){
+  return time(nullptr);
+}
+
 tm* get_localtime(){
-  time_t now = time(nullptr);
+  time_t now = get_time();
   return localtime(&now);
 }
 
@@ -122,6 +126,8 @@ void ntp_config(){
     isTimeSet = true;
     showTime();
     Serial.println("NTP Callback : Time updated !");
+    if (app)
+      app->notifyClockChanged();
   });
   configTime(MYTZ, "pool.ntp.org");
 
@@ -138,6 +144,8 @@ void setUpOTA(){
     // No authentication by default
   ArduinoOTA.onStart([]() {
     hasOTAStarted = true;
+    if (app)
+      app->flushJournal();
     String type;
     if (ArduinoOTA.getCommand() == U_FLASH) {
       type = "sketch";
@@ -201,11 +209,23 @@ void setup() {
 }
 
 void loop() {
+    uint32_t mark = ESP.getCycleCount();
     MDNS.update();
+    mark = app->recordLoopPhase(LOOP_PHASE_MDNS, mark);
     ArduinoOTA.handle();
+    mark = app->recordLoopPhase(LOOP_PHASE_OTA, mark);
     
     if (!hasOTAStarted){
       httpServer->handleClient();
+      mark = app->recordLoopPhase(LOOP_PHASE_HTTP, mark);
       app->update();
+      mark = app->recordLoopPhase(LOOP_PHASE_APP, mark);
+      httpServer->serviceEvents();
+      mark = app->recordLoopPhase(LOOP_PHASE_EVENTS, mark);
+      httpServer->servicePush();
+      mark = app->recordLoopPhase(LOOP_PHASE_PUSH, mark);
     }
+    Log.stream(Serial);
+    app->recordLoopPhase(LOOP_PHASE_LOG, mark);
+    Heap.sample();
 }
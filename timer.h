@@ -1,8 +1,11 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include "Log.h"
+
 #define SINGLE_SHOT 1
 #define LOOP_UNTIL_STOP 2
+#define WALL_CLOCK 3 //Scheduler only: fires every day at a fixed second of the day
 
 #define UNIT_MS 0
 #define UNIT_S 1
@@ -22,6 +25,8 @@
 #include <functional>
 #include <time.h>
 
+time_t get_time(); // Defined in main ! (simulated clock on the host build)
+
 class Timer {
     public:
         Timer(unsigned long interval, unsigned int type, std::function<void()> function){
@@ -37,12 +42,11 @@ class Timer {
             // Pooling only
             this->interval = interval;
             this->type = type;
-            Serial.print("Timer set for ");
-            Serial.println(interval);
+            LOG_DEBUG("Timer set for %lu", interval);
         };
 
         bool update(){
-            unsigned long time_sec = time(NULL);
+            unsigned long time_sec = get_time();
             return this->update(time_sec);
         };
 
@@ -73,7 +77,7 @@ class Timer {
 
         void start(bool reset){
            if (reset)
-              this->previousCall = time(NULL);
+              this->previousCall = get_time();
 
            start();
         }
@@ -84,7 +88,7 @@ class Timer {
 
         unsigned long remainingTime(){
           if (this->started){
-            unsigned long time_sec = time(NULL);
+            unsigned long time_sec = get_time();
             return interval - (time_sec - previousCall);
           }
 
@@ -97,7 +101,7 @@ class Timer {
 
         void setInterval(unsigned long interv){
            this->interval = interv;
-           Serial.printf("Timer set for %d", interval);            
+           LOG_DEBUG("Timer set for %lu", interval);
         }
 
         static unsigned long getIntervalFromUnit(float amout, int unit){
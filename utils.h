@@ -7,23 +7,32 @@
 #include <ArduinoJson.h>
 #include <FS.h>
 #include <LittleFS.h>
-#include <vector>
 
 tm* get_localtime(); // Defined in main ! 
 
-unsigned long timeToSecFromString(const char * time){
-  Serial.print("Time to str input : ");
-  Serial.println(time);
-  
-  unsigned long result = 0;
-  char * timeCopy = strdup(time);
-  char * part = strtok(timeCopy, ":");
-  result += atoi(part) * HOUR_MIN * MIN_S;
-  part = strtok(NULL, ":");
-  result += atoi(part) * MIN_S;
+// Parses "H:MM" / "HH:MM" into minutes since midnight without touching the heap
+unsigned int timeToMinFromString(const char * time){
+  unsigned int hours = 0;
+  unsigned int minutes = 0;
 
-  free(timeCopy);
-  return result;
+  while (*time >= '0' && *time <= '9'){
+    hours = hours * 10 + (*time - '0');
+    time++;
+  }
+  if (*time == ':')
+    time++;
+  while (*time == ' ')
+    time++;
+  while (*time >= '0' && *time <= '9'){
+    minutes = minutes * 10 + (*time - '0');
+    time++;
+  }
+
+  return hours * HOUR_MIN + minutes;
+}
+
+unsigned long timeToSecFromString(const char * time){
+  return (unsigned long) timeToMinFromString(time) * MIN_S;
 }
 
 bool formatFs(){
@@ -31,26 +40,16 @@ bool formatFs(){
   LittleFS.format();
 }
 
-void secToTimeString(unsigned long seconds, char * dest){
-
-  if (seconds >= HOUR_MIN * MIN_S * DAY_H)
-    seconds = (HOUR_MIN * MIN_S * DAY_H) - 60;
+// dest must hold at least 6 chars ("23:59")
+void minToTimeString(unsigned int minutes, char * dest){
+  if (minutes >= HOUR_MIN * DAY_H)
+    minutes = (HOUR_MIN * DAY_H) - 1;
 
-  unsigned int hours = seconds/(HOUR_MIN * MIN_S);
-  unsigned int minutes = (seconds - (hours * HOUR_MIN * MIN_S ))/MIN_S;
+  snprintf(dest, 6, "%u:%02u", minutes / HOUR_MIN, minutes % HOUR_MIN);
+}
 
-  Serial.print("Seconds ");
-  Serial.print(seconds);
-  Serial.print(" Hour : ");
-  Serial.print(hours);
-  Serial.print(" Min : ");
-  Serial.println(minutes);
-  
-  int s = sprintf(dest, "%d:%2d", hours, minutes);
-  dest[s]= '\0';
-  Serial.print("Read back the string ");
-  Serial.println(dest);
-  
+void secToTimeString(unsigned long seconds, char * dest){
+  minToTimeString(seconds / MIN_S, dest);
 }
 
 unsigned long timeToSec(unsigned int hours, unsigned int minutes){
@@ -58,15 +57,6 @@ unsigned long timeToSec(unsigned int hours, unsigned int minutes){
   return result;
 }
 
-bool has_value(std::vector<unsigned int> array, unsigned int month){
-  for(unsigned int v: array) {
-    if (v == month){
-      return true;
-    }
-  }
-  return false;
-}
-
 float mapfloat(float x, float in_min, float in_max, float out_min, float out_max)
 {
   return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
@@ -5,7 +5,7 @@
 #include <Arduino.h>
 #include <WiFiClient.h>
 #include <WiFiServer.h>
-#include <ESP8266WebServer.h>
+#include "WebServerBackend.h"
 #include <WiFiUdp.h>
 #include <flash_hal.h>
 #include <FS.h>
@@ -15,6 +15,13 @@
 #include <LittleFS.h>
 #include "app.h"
 #include "mini_prom_client.h"
+#include "ChunkedPrint.h"
+#include "Log.h"
+#include "HeapMonitor.h"
+#include "AssetCache.h"
+#include "EventStream.h"
+#include "CompactWriter.h"
+#include "MetricsPush.h"
 #include "fileConstants.h"
 #include <EspSaveCrash.h>
 
@@ -22,44 +29,106 @@
 #define FS_INIT_ERROR "FS INIT ERROR"
 #define FILE_NOT_FOUND "FileNotFound"
 #define fsName "LittleFS"
+#define WEB_MAX_ENDPOINTS 32
+#define STATUS_COMPACT_MAX 384 // Encoded /api/status, full timetable and season included
 
+// Map keys of the CBOR and MessagePack /api/status, in the order of the JSON fields.
+// Timetables are arrays of [on, off] in minutes since midnight
+typedef enum {
+  STATUS_CURRENT_TIMESTAMP,
+  STATUS_UPTIME,
+  STATUS_REMAINING_MANUAL_TIME,
+  STATUS_IS_MANUAL,
+  STATUS_LAST_TABLE_UPDATE,
+  STATUS_TEMPERATURE,
+  STATUS_RTL_TEMPERATURE,
+  STATUS_IS_PUMP_ACTIVATED,
+  STATUS_PH_LEVEL,
+  STATUS_PH_RAW,
+  STATUS_ORP_RAW,
+  STATUS_ORP_CL_BR_LEVEL,
+  STATUS_AMBIANT_TEMPERATURE,
+  STATUS_WATER_LEVEL,
+  STATUS_VERSION,
+  STATUS_FILTER_PRESSURE,
+  STATUS_FILTER_PRESSURE_VLT,
+  STATUS_FILTER_PRESSURE_NOISE,
+  STATUS_FILTER_PRESSURE_SAMPLES,
+  STATUS_NEXT_PUMP_TRANSITION,
+  STATUS_NEXT_PUMP_STATE,
+  STATUS_CURRENT_TIMETABLE,
+  STATUS_CURRENT_SEASON, // Map of the SEASON_* keys
+  STATUS_KEYS
+} StatusKey;
 
-class Webserver : public ESP8266WebServer {
+typedef enum {
+  SEASON_NAME,
+  SEASON_TABLE,
+  SEASON_MONTHS,
+  SEASON_KEYS
+} SeasonKey;
+// Static files below this path have content-hashed names and never change
+#define ASSET_IMMUTABLE_PREFIX "/assets/"
+
+// Requests served by one route and the heap its handler used
+typedef struct {
+  const char * uri;
+  HTTPMethod method;
+  unsigned long requests;
+  unsigned long allocations; // Counted with UMM_STATS_FULL only
+  uint32_t lastPeak; // Bytes of heap held at the peak of the last request
+  uint32_t maxPeak;
+} EndpointStats;
+
+
+class Webserver : public WebServerBackend {
   public:
-    Webserver( App* app_ptr, EspSaveCrash* ch, int port = 80) : ESP8266WebServer(port) {
+    Webserver( App* app_ptr, EspSaveCrash* ch, int port = 80) : WebServerBackend(port) {
       this->app = app_ptr;
       this->crashHandler = ch;
       //this->getServer().setServerKeyAndCert_P(rsakey, sizeof(rsakey), x509, sizeof(x509));
       fsOK = LittleFS.begin();
-      Serial.println(fsOK ? F("Filesystem initialized.") : F("Filesystem init failed!"));
+      if (fsOK)
+        LOG_INFO("Filesystem initialized");
+      else
+        LOG_ERROR("Filesystem init failed");
 
-      on("/", HTTP_GET, std::bind(&Webserver::handleGetIndex, this));
+      static const char * headerKeys[] = {"If-None-Match", "Accept"};
+      collectHeaders(headerKeys, sizeof(headerKeys) / sizeof(headerKeys[0]));
+      this->bootId = ESP.random();
+
+      route("/", HTTP_GET, std::bind(&Webserver::handleGetIndex, this));
       
       //Initialize routes
-      on("/up", HTTP_GET, std::bind(&Webserver::handleGetUp, this));
+      route("/up", HTTP_GET, std::bind(&Webserver::handleGetUp, this));
       
       // FSBrowser Routes
-      on("/status", HTTP_GET, std::bind(&Webserver::handleStatus, this));
-      on("/list", HTTP_GET, std::bind(&Webserver::handleFileList, this));
-      on("/edit", HTTP_GET, std::bind(&Webserver::handleGetEdit, this));
-      on("/edit",  HTTP_PUT, std::bind(&Webserver::handleFileCreate, this));
-      on("/edit",  HTTP_DELETE, std::bind(&Webserver::handleFileDelete, this));
-      on("/edit",  HTTP_POST, std::bind(&Webserver::replyOK,this), std::bind(&Webserver::handleFileUpload, this));
-      on("/api/prometheus", HTTP_GET, std::bind(&Webserver::handleGetStats, this));
-      on("/state", HTTP_GET, std::bind(&Webserver::handleGetState, this));
+      route("/status", HTTP_GET, std::bind(&Webserver::handleStatus, this));
+      route("/list", HTTP_GET, std::bind(&Webserver::handleFileList, this));
+      route("/edit", HTTP_GET, std::bind(&Webserver::handleGetEdit, this));
+      route("/edit",  HTTP_PUT, std::bind(&Webserver::handleFileCreate, this));
+      route("/edit",  HTTP_DELETE, std::bind(&Webserver::handleFileDelete, this));
+      route("/edit",  HTTP_POST, std::bind(&Webserver::replyOK,this), std::bind(&Webserver::handleFileUpload, this));
+      route("/api/prometheus", HTTP_GET, std::bind(&Webserver::handleGetStats, this));
+      route("/state", HTTP_GET, std::bind(&Webserver::handleGetState, this));
 
       //on("/api/update", HTTP_GET, std::bind(&Webserver::handleGetUpdate, this)); //May be useless or for improved compatibility
-      on("/api/update", HTTP_POST, std::bind(&Webserver::handlePostUpdate, this), std::bind(&Webserver::handlePostUpdateFile, this));
+      route("/api/update", HTTP_POST, std::bind(&Webserver::handlePostUpdate, this), std::bind(&Webserver::handlePostUpdateFile, this));
 
-      on("/api/manual", HTTP_PUT, std::bind(&Webserver::handlePutManual, this));
-      on("/api/manual", HTTP_DELETE, std::bind(&Webserver::handleDeleteManual, this));
+      route("/api/manual", HTTP_PUT, std::bind(&Webserver::handlePutManual, this));
+      route("/api/manual", HTTP_DELETE, std::bind(&Webserver::handleDeleteManual, this));
 
-      on("/api/status", HTTP_GET, std::bind(&Webserver::handleAPIGetStatus, this));
-      on("/api/reboot", HTTP_POST, std::bind(&Webserver::handleAPIPostReboot, this));
-      on("/api/help", HTTP_GET, std::bind(&Webserver::handleAPIGetHelp, this));
+      route("/api/status", HTTP_GET, std::bind(&Webserver::handleAPIGetStatus, this));
+      route("/api/reboot", HTTP_POST, std::bind(&Webserver::handleAPIPostReboot, this));
+      route("/api/help", HTTP_GET, std::bind(&Webserver::handleAPIGetHelp, this));
+      route("/api/history", HTTP_GET, std::bind(&Webserver::handleAPIGetHistory, this));
+      route("/api/journal", HTTP_GET, std::bind(&Webserver::handleAPIGetJournal, this));
+      route("/api/log", HTTP_GET, std::bind(&Webserver::handleAPIGetLog, this));
+      route("/api/log", HTTP_PUT, std::bind(&Webserver::handleAPIPutLog, this));
+      route("/api/events", HTTP_GET, std::bind(&Webserver::handleAPIGetEvents, this));
 
-      on("/api/crash", HTTP_GET, std::bind(&Webserver::handleAPIGetCrash, this)); //Get crash report
-      on("/api/crash", HTTP_DELETE, std::bind(&Webserver::handleAPIPutCrash, this)); // Clear crash report
+      route("/api/crash", HTTP_GET, std::bind(&Webserver::handleAPIGetCrash, this)); //Get crash report
+      route("/api/crash", HTTP_DELETE, std::bind(&Webserver::handleAPIPutCrash, this)); // Clear crash report
 
 
       // on("/api/config/",
@@ -67,10 +136,40 @@ class Webserver : public ESP8266WebServer {
 
 
       //Default handler
-      onNotFound(std::bind(&Webserver::routeNotFound, this));
+      uint8_t files = addEndpoint("*", HTTP_ANY);
+      onNotFound([this, files](){ this->measure(files, std::bind(&Webserver::routeNotFound, this), true); });
 
       
     }
+
+    // Called once per loop after App::update(): everything that changed during the
+    // pass goes out as one event per part, then the queues are written as the TCP windows allow
+    void serviceEvents(){
+      uint8_t parts = this->app->takeChangedParts();
+      if (parts && this->events.hasSubscribers())
+        publishEvents(parts);
+      this->events.service();
+    }
+
+    // Called once per loop: captures and sends the metric batches, no-op without METRICS_PUSH
+    void servicePush(){
+#if METRICS_PUSH
+      this->push.service();
+#endif
+    }
+
+    // /api/status bodies without the HTTP exchange, for bench_status. The JSON one is
+    // rebuilt on each call and lacks the clock fields; compact returns 0 on overflow
+    const String & statusJson(){
+      buildStatusBody();
+      return this->statusBody;
+    }
+
+    size_t statusCompact(uint8_t * buffer, size_t capacity, CompactFormat format){
+      CompactWriter out(buffer, capacity, format);
+      encodeStatus(out);
+      return out.overflowed() ? 0 : out.size();
+    }
   private:
 
     String unsupportedFiles = String();
@@ -79,6 +178,64 @@ class Webserver : public ESP8266WebServer {
     App * app;
     String _updaterError;
     EspSaveCrash * crashHandler;
+    String statusBody; //Serialized /api/status without the clock fields
+    uint32_t statusVersion = 0; //App state version statusBody was built from
+    uint32_t bootId; //Keeps ETags from a previous boot from matching
+    AssetCache assets; //Static file metadata for handleFileRead
+    EventStream events; //Subscribers of /api/events
+#if METRICS_PUSH
+    MetricsPush push{[this](MiniPromClient &client){ this->writeMetrics(client); }};
+#endif
+    uint32_t notModified = 0; //Static files answered with 304
+    EndpointStats endpoints[WEB_MAX_ENDPOINTS];
+    uint8_t endpointCount = 0;
+
+    uint8_t addEndpoint(const char * uri, HTTPMethod method){
+      if (this->endpointCount == WEB_MAX_ENDPOINTS) {
+        LOG_ERROR("Too many endpoints, %s is counted with the last one", uri);
+        return WEB_MAX_ENDPOINTS - 1;
+      }
+      this->endpoints[this->endpointCount] = {uri, method, 0, 0, 0, 0};
+      return this->endpointCount++;
+    }
+
+    // on() with heap accounting of the handler, upload chunks count as allocations of the same endpoint
+    void route(const char * uri, HTTPMethod method, THandlerFunction fn, THandlerFunction uploadFn = nullptr){
+      uint8_t index = addEndpoint(uri, method);
+      THandlerFunction handler = [this, index, fn](){ this->measure(index, fn, true); };
+      if (uploadFn)
+        on(uri, method, handler, [this, index, uploadFn](){ this->measure(index, uploadFn, false); });
+      else
+        on(uri, method, handler);
+    }
+
+    void measure(uint8_t index, const THandlerFunction &fn, bool request){
+      EndpointStats &endpoint = this->endpoints[index];
+      Heap.beginRequest();
+      fn();
+      uint32_t peak, allocations;
+      Heap.endRequest(peak, allocations);
+      endpoint.allocations += allocations;
+      if (!request)
+        return;
+      endpoint.requests++;
+      endpoint.lastPeak = peak;
+      if (peak > endpoint.maxPeak)
+        endpoint.maxPeak = peak;
+    }
+
+    static const char * methodName(HTTPMethod method){
+      switch (method) {
+        case HTTP_GET: return "GET";
+        case HTTP_HEAD: return "HEAD";
+        case HTTP_POST: return "POST";
+        case HTTP_PUT: return "PUT";
+        case HTTP_PATCH: return "PATCH";
+        case HTTP_DELETE: return "DELETE";
+        case HTTP_OPTIONS: return "OPTIONS";
+        default: return "ANY";
+      }
+    }
 
 
     void _setUpdaterError()
@@ -124,7 +281,7 @@ class Webserver : public ESP8266WebServer {
           return replyServerError(FPSTR(FS_INIT_ERROR));
         }
       
-        String uri = ESP8266WebServer::urlDecode(this->uri()); // required to read paths with blanks
+        String uri = WebServerBackend::urlDecode(this->uri()); // required to read paths with blanks
       
         if (handleFileRead(uri)) {
           return;
@@ -150,7 +307,7 @@ class Webserver : public ESP8266WebServer {
         message += "path=";
         message += this->arg("path");
         message += '\n';
-        Serial.print(message);
+        LOG_INFO("Not found: %s", this->uri());
       
         return replyNotFound(message);
     }
@@ -176,19 +333,18 @@ class Webserver : public ESP8266WebServer {
     }
     
     void replyBadRequest(String msg) {
-      Serial.println(msg);
+      LOG_WARN("Bad request %s: %s", this->uri(), msg);
       this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
       this->send(400, FPSTR(TEXT_PLAIN), msg + "\r\n");
     }
     
     void replyServerError(String msg) {
-      Serial.println(msg);
+      LOG_ERROR("Server error %s: %s", this->uri(), msg);
       this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
       this->send(500, FPSTR(TEXT_PLAIN), msg + "\r\n");
     }
 
     void handleStatus() {
-      Serial.println("handleStatus");
       FSInfo fs_info;
       String json;
       json.reserve(128);
@@ -227,7 +383,7 @@ class Webserver : public ESP8266WebServer {
         return replyBadRequest("BAD PATH");
       }
     
-      Serial.println(String("handleFileList: ") + path);
+      LOG_DEBUG("handleFileList: %s", path);
       Dir dir = LittleFS.openDir(path);
       path.clear();    
     
@@ -278,7 +434,7 @@ class Webserver : public ESP8266WebServer {
     }
 
     bool handleFileRead(String path) {
-      Serial.println(String("handleFileRead: ") + path);
+      LOG_DEBUG("handleFileRead: %s", path);
       if (!fsOK) {
         replyServerError(FPSTR(FS_INIT_ERROR));
         return true;
@@ -296,19 +452,70 @@ class Webserver : public ESP8266WebServer {
         contentType = mime::getContentType(path);
       }
     
-      if (!LittleFS.exists(path)) {
-        // File not found, try gzip version
-        path = path + ".gz";
-      }
-      if (LittleFS.exists(path)) {
-        File file = LittleFS.open(path, "r");
-        if (this->streamFile(file, contentType) != file.size()) {
-          Serial.println("Sent less data than expected!");
+      const AssetEntry * asset = this->assets.lookup(path);
+      if (!asset->exists)
+        return false;
+
+      // A 304 needs no file. Otherwise the validators only go out once the file opened,
+      // the 404 of a stale cache entry must not be cached for a year
+      bool validated = asset->etag[0] && etagMatches(asset->etag);
+      File file;
+      if (!validated) {
+        file = LittleFS.open(asset->gzip ? path + ".gz" : path, "r");
+        if (!file) {
+          // Removed behind the cache, e.g. by a file system image update
+          this->assets.clear();
+          return false;
         }
-        file.close();
+      }
+
+      if (asset->etag[0]) {
+        this->sendHeader(F("ETag"), asset->etag);
+        if (strncmp(path.c_str(), ASSET_IMMUTABLE_PREFIX, strlen(ASSET_IMMUTABLE_PREFIX)) == 0)
+          this->sendHeader(F("Cache-Control"), F("public, max-age=31536000, immutable"));
+        else
+          this->sendHeader(F("Cache-Control"), F("no-cache"));
+      }
+      if (validated) {
+        this->notModified++;
+        this->send(304);
         return true;
       }
-    
+      // Not closed: MultiWebServer keeps reading it after the handler returns
+      if (this->streamFile(file, contentType) != file.size()) {
+        LOG_WARN("Sent less data than expected for %s", path);
+      }
+      return true;
+    }
+
+    // If-None-Match holds "*" or a comma-separated list of entity tags. Weak comparison
+    // (RFC 7232): W/ is ignored on both sides, the quoted tags must be equal
+    bool etagMatches(const char * etag) {
+      if (!hasHeader(F("If-None-Match")))
+        return false;
+      if (strncmp(etag, "W/", 2) == 0)
+        etag += 2;
+      size_t length = strlen(etag);
+
+      String list = header(F("If-None-Match"));
+      const char * p = list.c_str();
+      while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',')
+          p++;
+        const char * end = p;
+        while (*end && *end != ',')
+          end++;
+        const char * last = end;
+        while (last > p && (last[-1] == ' ' || last[-1] == '\t'))
+          last--;
+        if (last - p == 1 && *p == '*')
+          return true;
+        if (last - p > 2 && strncmp(p, "W/", 2) == 0)
+          p += 2;
+        if ((size_t) (last - p) == length && strncmp(p, etag, length) == 0)
+          return true;
+        p = end;
+      }
       return false;
     }
 
@@ -320,7 +527,6 @@ class Webserver : public ESP8266WebServer {
           path = String();  // No slash => the top folder does not exist
         }
       }
-      Serial.println(String("Last existing parent: ") + path);
       return path;
     }
     
@@ -344,15 +550,17 @@ class Webserver : public ESP8266WebServer {
     String src = this->arg("src");
     if (src.isEmpty()) {
       // No source specified: creation
-      Serial.println(String("handleFileCreate: ") + path);
+      LOG_INFO("handleFileCreate: %s", path);
       if (path.endsWith("/")) {
         // Create a folder
         path.remove(path.length() - 1);
+        this->assets.clear();
         if (!LittleFS.mkdir(path)) {
           return replyServerError(F("MKDIR FAILED"));
         }
       } else {
         // Create a file
+        this->assets.clear();
         File file = LittleFS.open(path, "w");
         if (file) {
           file.write((const char *)0);
@@ -374,7 +582,7 @@ class Webserver : public ESP8266WebServer {
         return replyBadRequest(F("SRC FILE NOT FOUND"));
       }
   
-      Serial.println(String("handleFileCreate: ") + path + " from " + src);
+      LOG_INFO("handleFileCreate: %s from %s", path, src);
   
       if (path.endsWith("/")) {
         path.remove(path.length() - 1);
@@ -382,6 +590,7 @@ class Webserver : public ESP8266WebServer {
       if (src.endsWith("/")) {
         src.remove(src.length() - 1);
       }
+      this->assets.clear();
       if (!LittleFS.rename(src, path)) {
         return replyServerError(F("RENAME FAILED"));
       }
@@ -421,10 +630,11 @@ class Webserver : public ESP8266WebServer {
       return replyBadRequest("BAD PATH");
     }
   
-    Serial.println(String("handleFileDelete: ") + path);
+    LOG_INFO("handleFileDelete: %s", path);
     if (!LittleFS.exists(path)) {
       return replyNotFound(FPSTR(FILE_NOT_FOUND));
     }
+    this->assets.clear();
     deleteRecursive(path);
   
     replyOKWithMsg(lastExistingParent(path));
@@ -444,12 +654,12 @@ class Webserver : public ESP8266WebServer {
       if (!filename.startsWith("/")) {
         filename = "/" + filename;
       }
-      Serial.println(String("handleFileUpload Name: ") + filename);
+      this->assets.clear();
       uploadFile = LittleFS.open(filename, "w");
       if (!uploadFile) {
         return replyServerError(F("CREATE FAILED"));
       }
-      Serial.println(String("Upload: START, filename: ") + filename);
+      LOG_INFO("Upload: START, filename: %s", filename);
     } else if (upload.status == UPLOAD_FILE_WRITE) {
       if (uploadFile) {
         size_t bytesWritten = uploadFile.write(upload.buf, upload.currentSize);
@@ -457,12 +667,14 @@ class Webserver : public ESP8266WebServer {
           return replyServerError(F("WRITE FAILED"));
         }
       }
-      Serial.println(String("Upload: WRITE, Bytes: ") + upload.currentSize);
+      LOG_DEBUG("Upload: WRITE, Bytes: %u", upload.currentSize);
     } else if (upload.status == UPLOAD_FILE_END) {
       if (uploadFile) {
         uploadFile.close();
       }
-      Serial.println(String("Upload: END, Size: ") + upload.totalSize);
+      // Requests made during the upload may have cached the partial file
+      this->assets.clear();
+      LOG_INFO("Upload: END, Size: %u", upload.totalSize);
     }
   }
 
@@ -497,38 +709,188 @@ class Webserver : public ESP8266WebServer {
   }
   
   void handleGetStats(){
-      String message;
-
-      MiniPromClient client;
-
-      client.put("pool_temperature", "unit=\"C\"", String(this->app->getStatus()->rtlTemp));
-      client.put("pool_pump_status", String(this->app->getStatus()->isPumpActivated?1:0));
-      client.put("pool_is_manual", String(this->app->getStatus()->isManual?1:0));
-      client.put("pool_ph_level", String(this->app->getStatus()->pHLevel));
-      client.put("pool_ph_raw", String(this->app->getStatus()->pHRaw));
-      client.put("pool_OrpClBr_level", String(this->app->getStatus()->ORP_CL_BR));
-      client.put("pool_OrpClBr_raw", String(this->app->getStatus()->ORPRaw));
-      client.put("pool_manual_remaining_time", String(this->app->getRemainingManualTime()));
-      client.put("pool_ambiant_temperature", String(this->app->getStatus()->ambiantTemp));
-      client.put("pool_water_level", String(this->app->getStatus()->waterLevel));
-      client.put("pool_filter_pressure", String(this->app->getStatus()->filterPressure));
-      client.put("pool_filter_pressure_vlt", String(this->app->getStatus()->filterPressureVlt));
+      MiniPromClient client(*this);
 
-      //Add more metrics in the future
+      this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
+      client.begin();
+      writeMetrics(client);
+      client.end();
+  };
+
+  // Every metric, for /api/prometheus and the push batches. A batch is replayed
+  // through here, so the series must only depend on the build and the boot
+  void writeMetrics(MiniPromClient &client){
+      State * state = this->app->getStatus();
+
+      client.family(F("pool_temperature"), F("Water temperature"), GAUGE);
+      client.sample(state->rtlTemp, F("unit"), "C");
+      client.put(F("pool_pump_status"), F("Pump relay state, 1 when running"), GAUGE, state->isPumpActivated);
+      client.put(F("pool_is_manual"), F("1 when the pump is under manual control"), GAUGE, state->isManual);
+      client.put(F("pool_ph_level"), F("pH of the water"), GAUGE, state->pHLevel);
+      client.put(F("pool_ph_raw"), F("Raw pH probe reading"), GAUGE, state->pHRaw);
+      client.put(F("pool_OrpClBr_level"), F("ORP chlorine/bromine level"), GAUGE, state->ORP_CL_BR);
+      client.put(F("pool_OrpClBr_raw"), F("Raw ORP probe reading"), GAUGE, state->ORPRaw);
+      client.put(F("pool_manual_remaining_time"), F("Seconds left in manual mode"), GAUGE, this->app->getRemainingManualTime());
+      client.put(F("pool_ambiant_temperature"), F("Ambient temperature"), GAUGE, state->ambiantTemp);
+      client.put(F("pool_water_level"), F("Water level"), GAUGE, state->waterLevel);
+      client.put(F("pool_filter_pressure"), F("Smoothed filter pressure in PSI"), GAUGE, state->filterPressure);
+      client.put(F("pool_filter_pressure_vlt"), F("Last filter pressure sensor voltage"), GAUGE, state->filterPressureVlt);
+      client.put(F("pool_filter_pressure_noise"), F("Filter pressure noise estimate in PSI"), GAUGE, state->filterPressureNoise);
+      client.put(F("pool_filter_pressure_samples_total"), F("ADC readings of the filter pressure"), COUNTER, state->filterPressureSamples);
+
+      Scheduler * scheduler = this->app->getScheduler();
+      client.family(F("pool_scheduler_job_fired_total"), F("Times the scheduler job ran"), COUNTER);
+      for (JobId id = 0; id < scheduler->size(); id++)
+        client.sample(scheduler->job(id).fireCount, F("job"), scheduler->job(id).name);
+      client.family(F("pool_scheduler_job_lateness"), F("Seconds the last run of the job was late"), GAUGE);
+      for (JobId id = 0; id < scheduler->size(); id++)
+        client.sample(scheduler->job(id).lastLateness, F("job"), scheduler->job(id).name);
+      client.family(F("pool_scheduler_job_lateness_max"), F("Largest lateness of the job in seconds"), GAUGE);
+      for (JobId id = 0; id < scheduler->size(); id++)
+        client.sample(scheduler->job(id).maxLateness, F("job"), scheduler->job(id).name);
+
+      client.family(F("pool_config_load_us"), F("Time spent loading the configuration at boot"), GAUGE);
+      client.sample(this->app->getConfigLoadMicros(), F("source"), this->app->isConfigFromImage() ? "image" : "json");
+
+      client.family(F("pool_sensor_reads_total"), F("1-Wire sensor reads"), COUNTER);
+      for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        client.sample(this->app->getSensorStats(i).reads, F("sensor"), this->app->getSensorStats(i).name);
+      client.family(F("pool_sensor_failures_total"), F("1-Wire sensor reads that failed"), COUNTER);
+      for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        client.sample(this->app->getSensorStats(i).failures, F("sensor"), this->app->getSensorStats(i).name);
+      client.family(F("pool_sensor_latency_us"), F("Time from the last request to its result"), GAUGE);
+      for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        client.sample(this->app->getSensorStats(i).lastLatency, F("sensor"), this->app->getSensorStats(i).name);
+      client.family(F("pool_sensor_latency_max_us"), F("Longest time from a request to its result"), GAUGE);
+      for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        client.sample(this->app->getSensorStats(i).maxLatency, F("sensor"), this->app->getSensorStats(i).name);
+
+      const History &history = this->app->getHistory();
+      client.family(F("pool_history_bytes"), F("RAM used by the history tier"), GAUGE);
+      for (uint8_t i = 0; i < history.size(); i++) {
+        char tier[4];
+        snprintf(tier, sizeof(tier), "%u", i);
+        client.sample((unsigned long) history.tier(i).bytes(), F("tier"), tier);
+      }
+      client.family(F("pool_history_span_seconds"), F("Time covered by a full history tier"), GAUGE);
+      for (uint8_t i = 0; i < history.size(); i++) {
+        char tier[4];
+        snprintf(tier, sizeof(tier), "%u", i);
+        client.sample((unsigned long) history.tier(i).getPeriod() * history.tier(i).getCapacity(), F("tier"), tier);
+      }
+
+      Journal &journal = this->app->getJournal();
+      client.put(F("pool_journal_flash_bytes_total"), F("Bytes written to flash by the journal since boot"), COUNTER, journal.getBytesWritten());
+      client.family(F("pool_journal_flash_bytes_day"), F("Bytes written to flash by the journal per UTC day"), GAUGE);
+      client.sample(journal.getBytesPreviousDay(), F("day"), "previous");
+      client.sample(journal.getBytesToday(), F("day"), "current");
+      client.family(F("pool_journal_segments"), F("Journal segment files"), GAUGE);
+      client.sample((unsigned long) journal.segments(JOURNAL_RAW), F("level"), "raw");
+      client.sample((unsigned long) journal.segments(JOURNAL_COMPACT), F("level"), "compacted");
+      client.put(F("pool_journal_crc_errors_total"), F("Raw journal records dropped on a CRC mismatch when compacted"), COUNTER, journal.getCrcErrors());
+
+      client.put(F("pool_loop_stall_max_us"), F("Longest control loop pass since boot"), GAUGE, this->app->getLoopStallMax());
+      client.put(F("pool_loop_stall_recent_us"), F("Longest control loop pass during the previous minute"), GAUGE, this->app->getLoopStallRecent());
+
+      client.family(F("pool_loop_phase_us"), F("Time spent in each phase of loop()"), HISTOGRAM);
+      for (uint8_t i = 0; i < LOOP_PHASES; i++)
+        client.histogram(this->app->getLoopPhase(i), F("phase"), loopPhaseNames[i]);
+      client.family(F("pool_loop_phase_max_us"), F("Longest run of each phase of loop()"), GAUGE);
+      for (uint8_t i = 0; i < LOOP_PHASES; i++)
+        client.sample((unsigned long) this->app->getLoopPhase(i).getMax(), F("phase"), loopPhaseNames[i]);
+      client.family(F("pool_scheduler_job_us"), F("Time spent in the scheduler job callback"), HISTOGRAM);
+      for (JobId id = 0; id < scheduler->size(); id++)
+        client.histogram(scheduler->job(id).runTime, F("job"), scheduler->job(id).name);
+      client.family(F("pool_scheduler_job_max_us"), F("Longest run of the scheduler job callback"), GAUGE);
+      for (JobId id = 0; id < scheduler->size(); id++)
+        client.sample((unsigned long) scheduler->job(id).runTime.getMax(), F("job"), scheduler->job(id).name);
+      client.family(F("pool_sensor_bus_us"), F("Time loop() is blocked by a 1-Wire transaction"), HISTOGRAM);
+      for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        client.histogram(this->app->getSensorStats(i).busTime, F("sensor"), this->app->getSensorStats(i).name);
+      client.family(F("pool_sensor_bus_max_us"), F("Longest 1-Wire transaction"), GAUGE);
+      for (uint8_t i = 0; i < SENSOR_COUNT; i++)
+        client.sample((unsigned long) this->app->getSensorStats(i).busTime.getMax(), F("sensor"), this->app->getSensorStats(i).name);
 
-      replyOKWithMsg(client.getMessage());
+      Heap.update();
+      client.put(F("pool_heap_free_bytes"), F("Free heap"), GAUGE, (unsigned long) Heap.getFree());
+      client.put(F("pool_heap_max_block_bytes"), F("Largest free heap block"), GAUGE, (unsigned long) Heap.getMaxBlock());
+      client.put(F("pool_heap_fragmentation_percent"), F("Heap fragmentation, 0 when the free heap is one block"), GAUGE, (unsigned long) Heap.getFragmentation());
+      client.put(F("pool_heap_min_free_bytes"), F("Lowest free heap seen since boot"), GAUGE, (unsigned long) Heap.getMinFree());
+
+      char endpoint[48];
+      client.family(F("pool_http_requests_total"), F("Requests served by the endpoint"), COUNTER);
+      for (uint8_t i = 0; i < this->endpointCount; i++) {
+        snprintf(endpoint, sizeof(endpoint), "%s %s", methodName(this->endpoints[i].method), this->endpoints[i].uri);
+        client.sample(this->endpoints[i].requests, F("endpoint"), endpoint);
+      }
+      client.family(F("pool_http_heap_peak_bytes"), F("Most heap held by a request of the endpoint"), GAUGE);
+      for (uint8_t i = 0; i < this->endpointCount; i++) {
+        snprintf(endpoint, sizeof(endpoint), "%s %s", methodName(this->endpoints[i].method), this->endpoints[i].uri);
+        client.sample((unsigned long) this->endpoints[i].maxPeak, F("endpoint"), endpoint);
+      }
+      client.family(F("pool_http_heap_last_peak_bytes"), F("Heap held at the peak of the last request of the endpoint"), GAUGE);
+      for (uint8_t i = 0; i < this->endpointCount; i++) {
+        snprintf(endpoint, sizeof(endpoint), "%s %s", methodName(this->endpoints[i].method), this->endpoints[i].uri);
+        client.sample((unsigned long) this->endpoints[i].lastPeak, F("endpoint"), endpoint);
+      }
+#if HEAP_COUNTS_ALLOCATIONS
+      client.family(F("pool_http_allocations_total"), F("Heap allocations made by the endpoint handler"), COUNTER);
+      for (uint8_t i = 0; i < this->endpointCount; i++) {
+        snprintf(endpoint, sizeof(endpoint), "%s %s", methodName(this->endpoints[i].method), this->endpoints[i].uri);
+        client.sample(this->endpoints[i].allocations, F("endpoint"), endpoint);
+      }
+#endif
+
+      client.put(F("pool_asset_cache_hits_total"), F("Static file requests answered from the metadata cache"), COUNTER, (unsigned long) this->assets.getHits());
+      client.put(F("pool_asset_cache_misses_total"), F("Static file requests that probed the file system"), COUNTER, (unsigned long) this->assets.getMisses());
+      client.put(F("pool_asset_not_modified_total"), F("Static file requests answered with 304"), COUNTER, (unsigned long) this->notModified);
+      client.put(F("pool_events_subscribers"), F("Clients subscribed to /api/events"), GAUGE, (unsigned long) this->events.count());
+      client.put(F("pool_events_subscriptions_total"), F("Subscriptions to /api/events"), COUNTER, this->events.getSubscribed());
+      client.put(F("pool_events_published_total"), F("Events published"), COUNTER, this->events.getPublished());
+      client.put(F("pool_events_overflows_total"), F("Subscribers disconnected for falling behind"), COUNTER, this->events.getOverflows());
+#if WEB_BACKEND_MULTI
+      const MultiWebStats &web = this->getStats();
+      client.put(F("pool_http_connections_total"), F("Connections accepted"), COUNTER, web.accepted);
+      client.put(F("pool_http_connections_active"), F("Connections open"), GAUGE, (unsigned long) web.active);
+      client.put(F("pool_http_connections_max"), F("Most connections open at once"), GAUGE, (unsigned long) web.maxActive);
+      client.put(F("pool_http_rejected_total"), F("Requests refused by the server: malformed, too large or upload busy"), COUNTER, web.rejected);
+      client.put(F("pool_http_timeouts_total"), F("Connections closed for stalling in a request or response"), COUNTER, web.timeouts);
+      client.put(F("pool_http_reused_total"), F("Requests served on a kept-alive connection"), COUNTER, web.reused);
+      client.put(F("pool_http_pipelined_total"), F("Requests received before the previous response completed"), COUNTER, web.pipelined);
+      client.put(F("pool_http_idle_closed_total"), F("Kept-alive connections closed after being idle"), COUNTER, web.idleClosed);
+      client.put(F("pool_http_evicted_total"), F("Idle kept-alive connections closed to accept a new client"), COUNTER, web.evicted);
+      client.put(F("pool_http_blocked_writes_total"), F("Handler writes that waited for a slow client"), COUNTER, web.blockedWrites);
+#endif
+      client.put(F("pool_log_records_total"), F("Log records written since boot"), COUNTER, (unsigned long) Log.getNext());
+      client.put(F("pool_log_serial_missed_total"), F("Log records overwritten before reaching Serial"), COUNTER, Log.getSerialMissed());
+
+#if METRICS_PUSH
+      client.put(F("pool_push_queue_batches"), F("Metric batches waiting to be pushed"), GAUGE, (unsigned long) this->push.depth());
+      client.put(F("pool_push_batches_total"), F("Metric batches accepted by the push endpoint"), COUNTER, this->push.getPushed());
+      client.put(F("pool_push_failures_total"), F("Pushes that failed or were refused"), COUNTER, this->push.getFailures());
+      client.put(F("pool_push_dropped_samples_total"), F("Samples dropped from a full queue, refused by the endpoint or missing from a batch"), COUNTER, this->push.getDroppedSamples());
+      client.put(F("pool_push_last_latency_us"), F("Duration of the last successful push"), GAUGE, this->push.getLastLatency());
+      client.family(F("pool_push_latency_us"), F("Time from connecting to the push endpoint to its answer"), HISTOGRAM);
+      client.histogram(this->push.getLatency());
+#endif
+
+      //Add more metrics in the future
   };
 
   void handleGetState(){
     String message;
-    time_t now = time(NULL);
+    time_t now = get_time();
 
     message += "Current Time is : " + String(ctime(&now)) + "\n" ;
     message += "Temperature " + String(this->app->getStatus()->currentTemp) + "\n";
     message += "Time table :\n";
     int i=1;
-    for (TableObject o : this->app->getStatus()->timetable) {
-      message += String(i) + ". " + o.on + " - " + o.off + "\n";
+    for (const TableObject &o : this->app->getStatus()->timetable) {
+      char on[6];
+      char off[6];
+      minToTimeString(o.on, on);
+      minToTimeString(o.off, off);
+      message += String(i) + ". " + on + " - " + off + "\n";
       i++;
     }
 
@@ -538,9 +900,7 @@ class Webserver : public ESP8266WebServer {
   void handlePutManual(){
     StaticJsonDocument<200> jsonbuffer;
 
-    Serial.println("Body of manual put");
-    Serial.println(this->arg("plain"));
-    
+    LOG_DEBUG("Manual put: %s", this->arg("plain"));
     deserializeJson(jsonbuffer, this->arg("plain"));
     JsonObject obj = jsonbuffer.as<JsonObject>();
     
@@ -577,12 +937,13 @@ class Webserver : public ESP8266WebServer {
 
       if(upload.status == UPLOAD_FILE_START){
         _updaterError.clear();
+        this->app->flushJournal(); //Reboot follows, and a filesystem image replaces the journal
         
         Serial.setDebugOutput(true);
 
         WiFiUDP::stopAll();
         
-        Serial.printf("Update: %s\n", upload.filename.c_str());
+        LOG_INFO("Update: %s", upload.filename);
         
         if (upload.name == "filesystem") {
           size_t fsSize = ((size_t) &_FS_end - (size_t) &_FS_start);
@@ -597,20 +958,19 @@ class Webserver : public ESP8266WebServer {
           }
         }
       } else if(upload.status == UPLOAD_FILE_WRITE && !_updaterError.length()){
-        Serial.printf(".");
         if(Update.write(upload.buf, upload.currentSize) != upload.currentSize){
           _setUpdaterError();
         }
       } else if(upload.status == UPLOAD_FILE_END && !_updaterError.length()){
         if(Update.end(true)){ //true to set the size to the current progress
-          Serial.printf("Update Success: %u\nRebooting...\n", upload.totalSize);
+          LOG_INFO("Update Success: %u, rebooting", upload.totalSize);
         } else {
           _setUpdaterError();
         }
         Serial.setDebugOutput(false);
       } else if(upload.status == UPLOAD_FILE_ABORTED){
         Update.end();
-        Serial.println("Update was aborted");
+        LOG_WARN("Update was aborted");
       }
       delay(0);
   }
@@ -641,16 +1001,24 @@ class Webserver : public ESP8266WebServer {
     replyOK();
   }
 
-  void handleAPIGetStatus(){
-    Serial.printf("Heap is %d ", ESP.getFreeHeap());
+  // Table entries are kept as minutes in the App, format them only for the views
+  void addTableObject(JsonArray &array, const TableObject &o){
+    char on[6];
+    char off[6];
+    minToTimeString(o.on, on);
+    minToTimeString(o.off, off);
+
+    JsonObject arrayElement = array.createNestedObject();
+    arrayElement["on"] = on; // char* => copied into the document
+    arrayElement["off"] = off;
+  }
+
+  // Rebuilt only when the App state version moved
+  void buildStatusBody(){
     DynamicJsonDocument jsonbuffer(1024);
-    
-    String jsonMessage;
     State* state = this->app->getStatus();
     
     jsonbuffer["isManual"] = state->isManual;
-    jsonbuffer["remainingManualTime"] = state->isManual? this->app->getRemainingManualTime() : 0;
-    jsonbuffer["currentTimestamp"] = time(NULL);
     jsonbuffer["lastTableUpdate"] = state->lastTableUpdate;
     jsonbuffer["temperature"] = state->currentTemp;
     jsonbuffer["rtlTemperature"] = state->rtlTemp;
@@ -664,32 +1032,338 @@ class Webserver : public ESP8266WebServer {
     jsonbuffer["version"] = POOL_FW_VERSION;
     jsonbuffer["filterPressure"] = state->filterPressure;
     jsonbuffer["filterPressureVlt"] = state->filterPressureVlt;
-    jsonbuffer["uptime"] = millis() / 1000;
+    jsonbuffer["filterPressureNoise"] = state->filterPressureNoise;
+    jsonbuffer["filterPressureSamples"] = state->filterPressureSamples;
+    jsonbuffer["nextPumpTransition"] = this->app->getNextPumpTransition();
+    jsonbuffer["nextPumpState"] = this->app->getNextPumpState();
     
     JsonArray timetableArray = jsonbuffer.createNestedArray("currentTimetable");
-    for (TableObject o : state->timetable) {
-      JsonObject arrayElement = timetableArray.createNestedObject();
-      arrayElement["on"] = o.on;
-      arrayElement["off"] = o.off;    
+    for (const TableObject &o : state->timetable) {
+      addTableObject(timetableArray, o);
     }
 
     JsonObject seasonObject = jsonbuffer.createNestedObject("currentSeason");
     JsonArray tableArray = seasonObject.createNestedArray("table");
-    for (TableObject o : this->app->getSeason()->table) {
-      JsonObject arrayElement = tableArray.createNestedObject();
-      arrayElement["on"] = o.on;
-      arrayElement["off"] = o.off;    
-    }
-
     JsonArray monthsArray = seasonObject.createNestedArray("months");
-    for (unsigned int i : this->app->getSeason()->months) {
-      monthsArray.add(i);
+    const SeasonObject * season = this->app->getSeason();
+    if (season) {
+      for (const TableObject &o : season->table) {
+        addTableObject(tableArray, o);
+      }
+
+      for (unsigned int i : season->months) {
+        monthsArray.add(i);
+      }
     }
         
-    seasonObject["name"] = this->app->getSeason()->name;
+    seasonObject["name"] = season ? season->name : "";
+
+    this->statusBody.clear();
+    serializeJson(jsonbuffer, this->statusBody);
+    this->statusVersion = this->app->getStateVersion();
+  }
+
+  // One event per changed part, named after it, the state version as event id.
+  // The fields are those of /api/status so the dashboard can merge them as is
+  void publishEvents(uint8_t parts, int8_t only = -1){
+    State* state = this->app->getStatus();
+    uint32_t version = this->app->getStateVersion();
+    char data[EVENT_DATA_MAX + 1]; //Anything longer could not be queued whole
+
+    if (parts & STATE_PUMP) {
+      StaticJsonDocument<64> doc;
+      doc["isPumpActivated"] = state->isPumpActivated;
+      serializeJson(doc, data, sizeof(data));
+      this->events.publish("pump", version, data, only);
+    }
+    if (parts & STATE_MANUAL) {
+      StaticJsonDocument<64> doc;
+      doc["isManual"] = state->isManual;
+      doc["remainingManualTime"] = state->isManual ? this->app->getRemainingManualTime() : 0;
+      serializeJson(doc, data, sizeof(data));
+      this->events.publish("manual", version, data, only);
+    }
+    if (parts & STATE_TEMPERATURE) {
+      StaticJsonDocument<64> doc;
+      doc["rtlTemperature"] = state->rtlTemp;
+      serializeJson(doc, data, sizeof(data));
+      this->events.publish("temperature", version, data, only);
+    }
+    if (parts & STATE_WATER) {
+      StaticJsonDocument<192> doc;
+      doc["phLevel"] = state->pHLevel;
+      doc["phRaw"] = state->pHRaw;
+      doc["orpRaw"] = state->ORPRaw;
+      doc["OrpClBrLevel"] = state->ORP_CL_BR;
+      doc["ambiantTemperature"] = state->ambiantTemp;
+      doc["waterLevel"] = state->waterLevel;
+      serializeJson(doc, data, sizeof(data));
+      this->events.publish("water", version, data, only);
+    }
+    if (parts & STATE_PRESSURE) {
+      StaticJsonDocument<128> doc;
+      doc["filterPressure"] = state->filterPressure;
+      doc["filterPressureVlt"] = state->filterPressureVlt;
+      doc["filterPressureNoise"] = state->filterPressureNoise;
+      doc["filterPressureSamples"] = state->filterPressureSamples;
+      serializeJson(doc, data, sizeof(data));
+      this->events.publish("pressure", version, data, only);
+    }
+    if (parts & STATE_TIMETABLE) {
+      StaticJsonDocument<768> doc;
+      doc["lastTableUpdate"] = state->lastTableUpdate;
+      doc["temperature"] = state->currentTemp;
+      doc["nextPumpTransition"] = this->app->getNextPumpTransition();
+      doc["nextPumpState"] = this->app->getNextPumpState();
+      JsonArray timetableArray = doc.createNestedArray("currentTimetable");
+      for (const TableObject &o : state->timetable) {
+        addTableObject(timetableArray, o);
+      }
+      const SeasonObject * season = this->app->getSeason();
+      doc["season"] = season ? season->name : "";
+      // A truncated event would be invalid JSON for every subscriber
+      if (measureJson(doc) > EVENT_DATA_MAX) {
+        LOG_ERROR("Timetable event over %u bytes, not published", EVENT_DATA_MAX);
+      } else {
+        serializeJson(doc, data, sizeof(data));
+        this->events.publish("timetable", version, data, only);
+      }
+    }
+  }
+
+  // Server-sent events: the connection is handed over to events and stays open,
+  // the subscriber first gets a snapshot of every part
+  void handleAPIGetEvents(){
+    int8_t subscriber = this->events.subscribe(this->client());
+    if (subscriber < 0) {
+      this->sendHeader(F("Retry-After"), String(EVENT_RETRY_MS / 1000));
+      this->send(503, "text/plain", "TOO MANY SUBSCRIBERS");
+      return;
+    }
+    publishEvents(STATE_ALL, subscriber);
+  }
+
+  static void encodeTable(CompactWriter &out, const TimeTable &table){
+    out.array(table.size());
+    for (const TableObject &o : table) {
+      out.array(2);
+      out.unsignedInt(o.on);
+      out.unsignedInt(o.off);
+    }
+  }
+
+  // /api/status as CBOR or MessagePack, straight from the App state: no document, no cache
+  void encodeStatus(CompactWriter &out){
+    State* state = this->app->getStatus();
+    const SeasonObject * season = this->app->getSeason();
+
+    out.map(STATUS_KEYS);
+    out.key(STATUS_CURRENT_TIMESTAMP); out.signedInt(get_time());
+    out.key(STATUS_UPTIME); out.unsignedInt(millis() / 1000);
+    out.key(STATUS_REMAINING_MANUAL_TIME); out.unsignedInt(state->isManual ? this->app->getRemainingManualTime() : 0);
+    out.key(STATUS_IS_MANUAL); out.boolean(state->isManual);
+    out.key(STATUS_LAST_TABLE_UPDATE); out.unsignedInt(state->lastTableUpdate);
+    out.key(STATUS_TEMPERATURE); out.real(state->currentTemp);
+    out.key(STATUS_RTL_TEMPERATURE); out.real(state->rtlTemp);
+    out.key(STATUS_IS_PUMP_ACTIVATED); out.boolean(state->isPumpActivated);
+    out.key(STATUS_PH_LEVEL); out.real(state->pHLevel);
+    out.key(STATUS_PH_RAW); out.unsignedInt(state->pHRaw);
+    out.key(STATUS_ORP_RAW); out.unsignedInt(state->ORPRaw);
+    out.key(STATUS_ORP_CL_BR_LEVEL); out.real(state->ORP_CL_BR);
+    out.key(STATUS_AMBIANT_TEMPERATURE); out.real(state->ambiantTemp);
+    out.key(STATUS_WATER_LEVEL); out.real(state->waterLevel);
+    out.key(STATUS_VERSION); out.string(POOL_FW_VERSION);
+    out.key(STATUS_FILTER_PRESSURE); out.real(state->filterPressure);
+    out.key(STATUS_FILTER_PRESSURE_VLT); out.real(state->filterPressureVlt);
+    out.key(STATUS_FILTER_PRESSURE_NOISE); out.real(state->filterPressureNoise);
+    out.key(STATUS_FILTER_PRESSURE_SAMPLES); out.unsignedInt(state->filterPressureSamples);
+    out.key(STATUS_NEXT_PUMP_TRANSITION); out.signedInt(this->app->getNextPumpTransition());
+    out.key(STATUS_NEXT_PUMP_STATE); out.boolean(this->app->getNextPumpState());
+    out.key(STATUS_CURRENT_TIMETABLE); encodeTable(out, state->timetable);
+
+    out.key(STATUS_CURRENT_SEASON);
+    out.map(SEASON_KEYS);
+    if (!season) {
+      out.key(SEASON_NAME); out.string("");
+      out.key(SEASON_TABLE); out.array(0);
+      out.key(SEASON_MONTHS); out.array(0);
+      return;
+    }
+    out.key(SEASON_NAME); out.string(season->name);
+    out.key(SEASON_TABLE); encodeTable(out, season->table);
+    out.key(SEASON_MONTHS);
+    out.array(season->months.size());
+    for (uint8_t month : season->months)
+      out.unsignedInt(month);
+  }
+
+  // ?format=cbor|msgpack|json first, then Accept. -1 for JSON
+  int8_t statusFormat(){
+    String format = this->hasArg("format") ? this->arg("format") : this->header(F("Accept"));
+    if (format.indexOf(F("cbor")) >= 0)
+      return COMPACT_CBOR;
+    if (format.indexOf(F("msgpack")) >= 0)
+      return COMPACT_MSGPACK;
+    return -1;
+  }
+
+  // The ETag follows the state version and the format. currentTimestamp, uptime and remainingManualTime
+  // only follow the clock, they are prepended on each request and do not change it (weak ETag)
+  void handleAPIGetStatus(){
+    int8_t format = statusFormat();
+    char etag[28];
+    snprintf(etag, sizeof(etag), "W/\"%08x-%x%s\"", (unsigned) this->bootId, (unsigned) this->app->getStateVersion(),
+      format == COMPACT_CBOR ? "-c" : format == COMPACT_MSGPACK ? "-m" : "");
+
+    this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
+    this->sendHeader(F("ETag"), etag);
+    this->sendHeader(F("Cache-Control"), F("no-cache"));
+    this->sendHeader(F("Vary"), F("Accept"));
+
+    if (etagMatches(etag)) {
+      this->send(304);
+      return;
+    }
+
+    if (format >= 0) {
+      uint8_t buffer[STATUS_COMPACT_MAX];
+      CompactWriter out(buffer, sizeof(buffer), (CompactFormat) format);
+      encodeStatus(out);
+      if (out.overflowed()) {
+        LOG_ERROR("Status does not fit in %u bytes", STATUS_COMPACT_MAX);
+        this->send(500, "text/plain", "STATUS TOO LARGE");
+        return;
+      }
+      this->send(200, out.contentType(), (const char *) buffer, out.size());
+      return;
+    }
+
+    if (this->statusVersion != this->app->getStateVersion() || this->statusBody.length() == 0)
+      buildStatusBody();
+
+    State* state = this->app->getStatus();
+    char clock[96];
+    int clockLength = snprintf(clock, sizeof(clock), "{\"currentTimestamp\":%lld,\"uptime\":%lu,\"remainingManualTime\":%lu,",
+      (long long) get_time(), millis() / 1000, state->isManual ? this->app->getRemainingManualTime() : 0);
+
+    // statusBody always starts with '{', it is replaced by the clock fields
+    this->setContentLength(clockLength + this->statusBody.length() - 1);
+    this->send(200, "application/json", "");
+    this->sendContent(clock, clockLength);
+    this->sendContent(this->statusBody.c_str() + 1, this->statusBody.length() - 1);
+  }
+
+  // Without metric: tiers and memory budget. With metric: samples in [from, to] (epoch seconds,
+  // default the last 24 hours) from the finest tier covering from, streamed as [time, value] pairs
+  void handleAPIGetHistory(){
+    const History &history = this->app->getHistory();
+    ChunkedPrint out(*this);
+
+    if (!this->hasArg("metric")) {
+      this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
+      out.begin(200, "application/json");
+      out.printf("{\"bytes\":%u,\"maxBytes\":%u,\"tiers\":[", (unsigned) history.bytes(), HISTORY_MAX_BYTES);
+      for (uint8_t i = 0; i < history.size(); i++) {
+        const HistoryTier &tier = history.tier(i);
+        out.printf("%s{\"period\":%lu,\"capacity\":%u,\"samples\":%u,\"bytes\":%u,\"span\":%lu}", i ? "," : "",
+          (unsigned long) tier.getPeriod(), tier.getCapacity(), tier.size(), (unsigned) tier.bytes(), (unsigned long) tier.getPeriod() * tier.getCapacity());
+      }
+      out.print("],\"metrics\":[");
+      for (uint8_t m = 0; m < HISTORY_METRICS; m++)
+        out.printf("%s\"%s\"", m ? "," : "", historyMetrics[m].name);
+      out.print("]}");
+      out.end();
+      return;
+    }
+
+    int metric = History::findMetric(this->arg("metric"));
+    if (metric < 0 || history.size() == 0)
+      return replyBadRequest(F("UNKNOWN METRIC"));
+
+    time_t to = this->hasArg("to") ? (time_t) atoll(this->arg("to").c_str()) : get_time();
+    time_t from = this->hasArg("from") ? (time_t) atoll(this->arg("from").c_str()) : to - DAY_H * HOUR_MIN * MIN_S;
+    uint8_t tierIndex = history.selectTier(from);
+    const HistoryTier &tier = history.tier(tierIndex);
+    float scale = historyMetrics[metric].scale;
+    int decimals = scale >= 1000 ? 3 : scale >= 100 ? 2 : scale >= 10 ? 1 : 0;
+
+    this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
+    out.begin(200, "application/json");
+    out.printf("{\"metric\":\"%s\",\"tier\":%u,\"period\":%lu,\"from\":%lld,\"to\":%lld,\"points\":[",
+      historyMetrics[metric].name, tierIndex, (unsigned long) tier.getPeriod(), (long long) from, (long long) to);
+    bool first = true;
+    tier.forEach(metric, from, to, [&](time_t time, int16_t value){
+      if (value == HISTORY_GAP)
+        out.printf("%s[%lld,null]", first ? "" : ",", (long long) time);
+      else
+        out.printf("%s[%lld,%.*f]", first ? "" : ",", (long long) time, decimals, value / scale);
+      first = false;
+    });
+    out.print("]}");
+    out.end();
+  }
+
+  // Journal export as CSV, records in [from, to] (epoch seconds, default everything)
+  void handleAPIGetJournal(){
+    time_t from = this->hasArg("from") ? (time_t) atoll(this->arg("from").c_str()) : 0;
+    time_t to = this->hasArg("to") ? (time_t) atoll(this->arg("to").c_str()) : get_time();
+
+    ChunkedPrint out(*this);
+    this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
+    out.begin(200, "text/csv");
+    out.print("time");
+    for (uint8_t m = 0; m < HISTORY_METRICS; m++)
+      out.printf(",%s", historyMetrics[m].name);
+    out.print("\n");
+
+    this->app->getJournal().forEach(from, to, [&](const JournalRecord &record){
+      out.printf("%lu", (unsigned long) record.time);
+      for (uint8_t m = 0; m < HISTORY_METRICS; m++){
+        if (record.row.values[m] == HISTORY_GAP)
+          out.print(",");
+        else
+          out.printf(",%g", record.row.values[m] / (float) historyMetrics[m].scale);
+      }
+      out.print("\n");
+    });
+    out.end();
+  }
+
+  // Log ring as text, one "<seq> [<s.ms>] <level> <message>" line per record.
+  // since=<seq> only returns newer records, X-Log-Next is the value for the next poll
+  void handleAPIGetLog(){
+    uint32_t since = this->hasArg("since") ? strtoul(this->arg("since").c_str(), nullptr, 10) : Log.getFirst();
+    int level = this->hasArg("level") ? LogBuffer::parseLevel(this->arg("level")) : LOG_LEVEL_DEBUG;
+    if (level < 0)
+      return replyBadRequest(F("BAD LEVEL"));
+
+    ChunkedPrint out(*this);
+    this->sendHeader(F("Access-Control-Allow-Origin"), F("*"));
+    this->sendHeader(F("Cache-Control"), F("no-cache"));
+    this->sendHeader(F("X-Log-Next"), String(Log.getNext()));
+    out.begin(200, TEXT_PLAIN);
+    Log.print(out, since, level);
+    out.end();
+  }
+
+  // level= records kept in the ring, serial= records streamed to Serial ("none" turns it off)
+  void handleAPIPutLog(){
+    if (this->hasArg("level")) {
+      int level = LogBuffer::parseLevel(this->arg("level"));
+      if (level < 0)
+        return replyBadRequest(F("BAD LEVEL"));
+      Log.setLevel(level);
+    }
+    if (this->hasArg("serial")) {
+      int level = LogBuffer::parseLevel(this->arg("serial"));
+      if (level < 0)
+        return replyBadRequest(F("BAD LEVEL"));
+      Log.setSerialLevel(level);
+    }
 
-    serializeJson(jsonbuffer, jsonMessage);
-    replyOKWithJson( jsonMessage);
+    char json[48];
+    snprintf(json, sizeof(json), "{\"level\":\"%s\",\"serial\":\"%s\"}", LogBuffer::levelName(Log.getLevel()), LogBuffer::levelName(Log.getSerialLevel()));
+    replyOKWithJson(json);
   }
 
   void handleAPIGetHelp(){
@@ -697,6 +1371,7 @@ class Webserver : public ESP8266WebServer {
   }
 
   void handleAPIPostReboot(){
+    this->app->flushJournal();
     replyOK();
     delay(200);
     //Ask a reboot.